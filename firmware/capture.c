@@ -0,0 +1,91 @@
+// capture.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "capture.h"
+#include "hal.h"
+
+#if CAPTURE_ENA
+
+static uint8_t g_ring[CAPTURE_RING_SIZE][CAPTURE_ENTRY_SIZE];
+static uint8_t g_head, g_count;
+static uint16_t g_lost;
+static uint8_t g_mode = CAPTURE_CONTINUOUS;
+// Last pins recorded for each joystick port. 0xFF records the next read.
+static uint8_t g_joystick[2] = { 0xFF, 0xFF };
+
+void capture_byte(const uint8_t source, const uint8_t value)
+{
+    if (g_mode == CAPTURE_OFF)
+        return;
+    const uint16_t now = (uint16_t)hal_millis();
+    const uint8_t state = hal_irq_save();
+    if (g_count == CAPTURE_RING_SIZE) {
+        if (g_lost != 0xffff)
+            g_lost++;
+        if (g_mode == CAPTURE_UNTIL_FULL) {
+            hal_irq_restore(state);
+            return;
+        }
+        g_head = (g_head + 1) % CAPTURE_RING_SIZE;
+        g_count--;
+    }
+    uint8_t *e = g_ring[(g_head + g_count) % CAPTURE_RING_SIZE];
+    g_count++;
+    e[0] = now >> 8;
+    e[1] = now & 0xff;
+    e[2] = source;
+    e[3] = value;
+    hal_irq_restore(state);
+}
+
+void capture_joystick(const int port, const uint8_t gpio_value)
+{
+    const int i = port ? 1 : 0;
+    if (g_joystick[i] == gpio_value)
+        return;
+    g_joystick[i] = gpio_value;
+    capture_byte(CAPTURE_JOYSTICK0 + i, gpio_value);
+}
+
+void capture_set_mode(const uint8_t mode)
+{
+    const uint8_t state = hal_irq_save();
+    g_head = g_count = 0;
+    g_lost = 0;
+    g_mode = mode;
+    g_joystick[0] = g_joystick[1] = 0xFF;
+    hal_irq_restore(state);
+}
+
+uint8_t capture_count(void)
+{
+    return g_count;
+}
+
+uint16_t capture_take_lost(void)
+{
+    const uint8_t state = hal_irq_save();
+    const uint16_t lost = g_lost;
+    g_lost = 0;
+    hal_irq_restore(state);
+    return lost;
+}
+
+bool capture_pop(uint8_t entry[CAPTURE_ENTRY_SIZE])
+{
+    const uint8_t state = hal_irq_save();
+    const bool any = g_count > 0;
+    if (any) {
+        memcpy(entry, g_ring[g_head], CAPTURE_ENTRY_SIZE);
+        g_head = (g_head + 1) % CAPTURE_RING_SIZE;
+        g_count--;
+    }
+    hal_irq_restore(state);
+    return any;
+}
+
+#endif // CAPTURE_ENA
@@ -0,0 +1,71 @@
+// capture.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+
+// Optional input capture (CAPTURE_ENA): every byte read from the PS/2
+// keyboard and mouse and from the host, and every change of the joystick
+// port pins, with a time stamp in ms. The host drains it with the vendor
+// IKBD command 0xB5, and host/ikbd_capture.c turns it into a script that
+// replays the same inputs on the host build or the simulator.
+
+// Sources.
+enum {
+    CAPTURE_HOST,
+    CAPTURE_KEYBOARD,
+    CAPTURE_MOUSE,
+    CAPTURE_JOYSTICK0,
+    CAPTURE_JOYSTICK1,
+};
+
+// Modes, set with IKBD command 0x35.
+enum {
+    CAPTURE_OFF,
+    CAPTURE_UNTIL_FULL,     // keep the oldest inputs
+    CAPTURE_CONTINUOUS,     // keep the latest inputs (from power up)
+};
+
+#define CAPTURE_RING_SIZE 64
+#define CAPTURE_ENTRY_SIZE 4    // time (2), source, value
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if CAPTURE_ENA
+
+void capture_byte(uint8_t source, uint8_t value);
+// Record the raw pins of a joystick port when they change.
+void capture_joystick(int port, uint8_t gpio_value);
+
+// Empty the ring and start recording in the given mode.
+void capture_set_mode(uint8_t mode);
+// Number of inputs in the ring.
+uint8_t capture_count(void);
+// Inputs overwritten or not recorded for lack of room since the last call.
+uint16_t capture_take_lost(void);
+// Remove the oldest input, as CAPTURE_ENTRY_SIZE bytes. False if none left.
+bool capture_pop(uint8_t entry[CAPTURE_ENTRY_SIZE]);
+
+#define CAPTURE(source, value) capture_byte((source), (value))
+#define CAPTURE_JOYSTICK(port, gpio_value) capture_joystick((port), (gpio_value))
+
+#else
+
+#define CAPTURE(source, value) do { } while (0)
+#define CAPTURE_JOYSTICK(port, gpio_value) do { } while (0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CAPTURE_H
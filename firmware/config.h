@@ -7,6 +7,9 @@
 
 // Serial port
 #define SERIAL_BAUD_RATE 9600
+// Fastest rate the settings (command 0x36) accept. tools/isr_budget.py
+// checks that the USART receive interrupt keeps up at this rate.
+#define SERIAL_BAUD_RATE_MAX 57600
 
 #define KEYBOARD_ENA 1
 #define MOUSE_ENA 1
@@ -17,8 +20,71 @@
 #define PS2_MOUSE_DATA_PIN 4     // ATMEGA PIN 6
 #define PS2_KEYBOARD_DATA_PIN 5  // ATMEGA PIN 11
 
+// At most WATCHDOG_SETUP_MS / 2 (watchdog.h).
 #define PS2_TIMEOUT 2000
 
+// Key repeats are dropped before they reach the host (the IKBD doesn't
+// auto-repeat, TOS does). Also ask the keyboard to repeat as slowly as
+// possible (1 s delay, 2 repeats/s) so held keys cost little PS/2 traffic.
+#define PS2_KEYBOARD_SLOW_TYPEMATIC 1
+
+// While keys are down, check this often that the keyboard still answers,
+// so that they are released if it was unplugged.
+#define KEYBOARD_PING_MS 500
+
+// Use scan code set 3 (one code per key, no typematic) when the keyboard
+// supports it, falling back to set 2 otherwise.
+#define PS2_KEYBOARD_SET3 0
+
+// Where the letters are for a keyboard with US legends: KEYMAP_LAYOUT_US,
+// _UK, _DE or _FR for national TOS (see keymap.h, digits and punctuation
+// aren't remapped). Can be changed at run time with IKBD command 0x36.
+#define KEYBOARD_LAYOUT KEYMAP_LAYOUT_US
+
+// Automatic IKBD reports (mouse, joystick) are generated once per tick
+#define IKBD_REPORT_INTERVAL_MS 10
+
+// PS/2 mouse defaults, can be changed at run time with IKBD command 0x30
+#define PS2_MOUSE_SAMPLE_RATE 100   // samples/s: 10, 20, 40, 60, 80, 100 or 200
+#define PS2_MOUSE_RESOLUTION 2      // 0-3: 1, 2, 4 or 8 counts/mm
+#define PS2_MOUSE_SCALING 0         // 0 = 1:1, 1 = 2:1
+#define PS2_MOUSE_REMOTE_MODE 0     // 1 = poll the mouse once per report tick
+
+// Adaptive rate control: stretch the report tick and lower the mouse sample
+// rate while the output queue needs more than RATE_CONTROL_BACKLOG_MS to drain
+#define RATE_CONTROL_ENA 1
+#define RATE_CONTROL_PERIOD_MS 100
+#define RATE_CONTROL_BACKLOG_MS 50
+#define RATE_CONTROL_QUIET_PERIODS 5  // empty-queue periods before stepping back up
+
+// IKBD packets go out whole and back to back. Output can also be held back
+// for up to OUTPUT_GROUP_MS, or until OUTPUT_GROUP_BYTES are waiting, so
+// that packets queued close together (a key and a mouse report) share one
+// burst and a host can set its 16C550 receive FIFO trigger level that
+// high. 0 sends packets as soon as they are queued.
+#define OUTPUT_GROUP_MS 0
+#define OUTPUT_GROUP_BYTES 14
+
+// Profiler: histograms of main loop stage and interrupt handler times, read
+// with IKBD command 0xB3. Uses Timer2 and about 260 bytes of RAM.
+#define PROFILE_ENA 0
+
+// Event trace: commands and notable IKBD events with their arguments, read
+// with IKBD command 0xB4 and decoded by host/ikbd_trace.c. About 260 bytes
+// of RAM.
+#define TRACE_ENA 0
+
+// Input capture: PS/2 and host bytes and joystick changes, read with IKBD
+// command 0xB5 and replayed with host/ikbd_capture.c. About 260 bytes of RAM.
+#define CAPTURE_ENA 0
+
+// Also keep the IKBD state restored after an MCU reset in EEPROM, for
+// resets that lose RAM. The mouse position and clock change all the time,
+// so they are left out and come back as 0. Each host command that changes
+// the setup costs a few EEPROM writes, so this wears the EEPROM with
+// programs that change the mouse mode often.
+#define SNAPSHOT_EEPROM 0
+
 #define DEBUG 0
 
 #endif
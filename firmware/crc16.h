@@ -0,0 +1,20 @@
+// crc16.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stdint.h>
+
+// CRC-16/CCITT (polynomial 0x1021), for the EEPROM records. Start from
+// 0xffff.
+static inline uint16_t crc16_update(uint16_t crc, const uint8_t c)
+{
+    crc ^= (uint16_t)c << 8;
+    for (uint8_t i = 0; i < 8; i++)
+        crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    return crc;
+}
+
+#endif // CRC16_H
@@ -0,0 +1,24 @@
+// eeprom.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#include "eeprom.h"
+
+#include "hal.h"
+
+// EEPROM bytes compared per eeprom_sync() call, to bound its time.
+#define SYNC_COMPARES 16
+
+bool eeprom_sync(const uint16_t addr, const uint8_t *image, const uint8_t len, uint8_t *pos)
+{
+    if (*pos < len && !hal_eeprom_ready())
+        return false;
+    for (uint8_t n = 0; n < SYNC_COMPARES && *pos < len; n++) {
+        const uint8_t i = (*pos)++;
+        if (hal_eeprom_read(addr + i) != image[i]) {
+            hal_eeprom_write(addr + i, image[i]);
+            break;
+        }
+    }
+    return *pos >= len;
+}
@@ -0,0 +1,26 @@
+// eeprom.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bring the EEPROM at addr in line with its image in RAM, from the main
+// loop: each call compares a few bytes and writes at most one that
+// differs, as a write keeps the EEPROM busy for 3.4 ms. *pos is the next
+// byte to compare, set to 0 after the image changes. Return true once it
+// reaches len.
+bool eeprom_sync(uint16_t addr, const uint8_t *image, uint8_t len, uint8_t *pos);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EEPROM_H
@@ -0,0 +1,28 @@
+// eeprom_map.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#ifndef EEPROM_MAP_H
+#define EEPROM_MAP_H
+
+// Use of the ATmega328P's 1 KB EEPROM, through hal_eeprom_xxx().
+
+#define EEPROM_SIZE 1024
+
+// settings.c: 16 wear-levelled slots of 16 bytes.
+#define EEPROM_SETTINGS_ADDR 0
+#define EEPROM_SETTINGS_SIZE 256
+
+// remap.c: one copy of the key map and macros.
+#define EEPROM_REMAP_ADDR 256
+#define EEPROM_REMAP_SIZE 192
+
+// snapshot.c: the IKBD state set up by the host, with SNAPSHOT_EEPROM.
+#define EEPROM_SNAPSHOT_ADDR 448
+#define EEPROM_SNAPSHOT_SIZE 64
+
+// watchdog.c: stalls counted per main loop stage.
+#define EEPROM_WATCHDOG_ADDR 512
+#define EEPROM_WATCHDOG_SIZE 32
+
+#endif // EEPROM_MAP_H
@@ -7,18 +7,30 @@
 #include "ps2_mouse.h"
 
 #include "config.h"
+#include "hal.h"
 #include "ikbd.h"
+#include "input.h"
+#include "perf.h"
+#include "profile.h"
 #include "ps2.h"
+#include "rate_control.h"
+#include "remap.h"
+#include "settings.h"
+#include "snapshot.h"
 #include "util.h"
+#include "watchdog.h"
 
 PS2Keyboard keyboard;
 PS2Mouse mouse;
-KEYBOARD Keyboard;
-KEYBOARD_PROCESSOR KeyboardProcessor;
+static bool mouse_config_pending = true;
+// Devices started by setup(), as the flags at power up asked.
+static bool keyboard_started, mouse_started;
 
 #include <Arduino.h>
 
-#include "scan_code_maps_flash.c"
+#if DEBUG
+#include "keymap.h"
+#endif
 
 PROGMEM constexpr char key_press_msg[] = "    Key pressed: ";
 PROGMEM constexpr char key_release_msg[] = "    Key released: ";
@@ -27,54 +39,95 @@ PROGMEM constexpr char st_scan_code_msg[] = "    Atari ST Scan Code: 0x";
 
 void setup()
 {
-  // Configure the debug LED pin as output
-  pinMode(PIN7, OUTPUT);
-  Serial.begin(SERIAL_BAUD_RATE);
-
-  // Set up the joystick ports by setting bits 5:0 of ports B and C to inputs.
-  DDRB = DDRB & 0xC0;
-  DDRC = DDRC & 0xC0;
-  // And pull them up.
-  PORTB = PORTB | 0x3F;
-  PORTC = PORTC | 0x3F;
-
+  hal_init();
+  watchdog_begin();
+  PROFILE_INIT();
+  settings_boot();
+  remap_load();
+  Serial.begin(Settings.baud_rate);
+  MouseConfig.SampleRate = Settings.mouse_sample_rate;
+  MouseConfig.Resolution = Settings.mouse_resolution;
+  MouseConfig.Scaling = Settings.mouse_scaling;
+  MouseConfig.RemoteMode = Settings.mouse_remote_mode;
+
+    // A device that hung its reset last time is left alone until the next
+    // reset, rather than hanging every boot.
 #if KEYBOARD_ENA
-    PS2Keyboard::begin(PS2_KEYBOARD_CLK_PIN, PS2_KEYBOARD_DATA_PIN);
+    watchdog_check_in(WATCHDOG_SETUP_KEYBOARD);
+    if ((settings_boot_flags() & SETTINGS_KEYBOARD) && watchdog_stalled() != WATCHDOG_SETUP_KEYBOARD) {
+      PS2Keyboard::begin(PS2_KEYBOARD_CLK_PIN, PS2_KEYBOARD_DATA_PIN);
+      keyboard_started = true;
+    }
 #endif
 #if MOUSE_ENA
-    PS2Mouse::begin(PS2_MOUSE_CLK_PIN, PS2_MOUSE_DATA_PIN);
+    watchdog_check_in(WATCHDOG_SETUP_MOUSE);
+    if ((settings_boot_flags() & SETTINGS_MOUSE) && watchdog_stalled() != WATCHDOG_SETUP_MOUSE) {
+      PS2Mouse::begin(PS2_MOUSE_CLK_PIN, PS2_MOUSE_DATA_PIN);
+      mouse_started = true;
+    }
 #endif
-    IKBD_Reset(true);
+    watchdog_check_in(WATCHDOG_SETUP);
+    // After a reset of the MCU alone, carry on with the host's setup.
+    if (hal_reset_cause() & HAL_RESET_POWER_ON)
+      IKBD_Reset(true);
+    else
+      IKBD_MemorySnapShot_Capture(false);
+    watchdog_run();
 }
 
 void turn_LED_on()
 {
-  digitalWrite(PIN7, 0);
+  hal_led(true);
 }
 
 void turn_LED_off()
 {
-  digitalWrite(PIN7, 1);
+  hal_led(false);
 }
 
+// Hand whole packets to the serial port, as many as its transmit buffer
+// takes, so that the bytes of a packet, and the packets queued together,
+// go out back to back rather than one per loop() pass.
 void check_ikbd_output_buffer()
 {
-  if ( Keyboard.NbBytesInOutputBuffer > 0 && Keyboard.PauseOutput == false ) {
-    const unsigned char ch = Keyboard.Buffer[ Keyboard.BufferHead++ ];
-    Keyboard.BufferHead &= KEYBOARD_BUFFER_MASK;
-    Keyboard.NbBytesInOutputBuffer--;
-    send_byte(ch);
+#if OUTPUT_GROUP_MS
+  static bool grouping;
+  static unsigned long group_start;
+#endif
+  if ( Keyboard.NbBytesInOutputBuffer == 0 || Keyboard.PauseOutput ) {
+    return;
+  }
+#if OUTPUT_GROUP_MS
+  if ( !grouping ) {
+    grouping = true;
+    group_start = millis();
   }
+  if ( Keyboard.NbBytesInOutputBuffer < OUTPUT_GROUP_BYTES && millis() - group_start < OUTPUT_GROUP_MS ) {
+    return;
+  }
+#endif
+  int room = send_room();
+  while ( Keyboard.NbBytesInOutputBuffer > 0 ) {
+    int len = IKBD_OutputPacketLength();
+    if ( len > room ) {
+      break;
+    }
+    room -= len;
+    while ( len-- > 0 ) {
+      const unsigned char ch = Keyboard.Buffer[ Keyboard.BufferHead++ ];
+      Keyboard.BufferHead &= KEYBOARD_BUFFER_MASK;
+      Keyboard.NbBytesInOutputBuffer--;
+      send_byte(ch);
+      PerfCounters.bytes_sent++;
+      rate_control_byte_sent();
+    }
+  }
+#if OUTPUT_GROUP_MS
+  // What didn't fit goes on the next pass, without waiting again.
+  grouping = Keyboard.NbBytesInOutputBuffer > 0;
+#endif
 }
 
-#define Y_OVERFLOW (1 << 7)
-#define X_OVERFLOW (1 << 6)
-#define Y_SIGN (1 << 5)
-#define X_SIGN (1 << 4)
-#define MIDDLE_BUTTON (1 << 2)
-#define RIGHT_BUTTON (1 << 1)
-#define LEFT_BUTTON (1 << 0)
-
 #if DEBUG
 
 static void print_hex_byte(uint8_t value) {
@@ -100,8 +153,7 @@ static void show_st_scan_code(uint8_t code)
 static void show_key(uint8_t code, uint8_t extended, uint8_t brk)
 {
   char key[20];
-  if (extended) strcpy_P(key, reinterpret_cast<const char *>(pgm_read_word(&extended_ps2_make_code_map_flash[code])));
-  else strcpy_P(key, reinterpret_cast<const char *>(pgm_read_word(&ps2_make_code_map_flash[code])));
+  strcpy_P(key, keymap_key_name(code, extended));
   if (brk) Serial.print(reinterpret_cast<const __FlashStringHelper *>(key_release_msg));
   else Serial.print(reinterpret_cast<const __FlashStringHelper *>(key_press_msg));
 
@@ -112,112 +164,115 @@ static void show_key(uint8_t code, uint8_t extended, uint8_t brk)
 #endif
 
 extern "C" {
-  uint8_t Joy_GetStickData(const int nStJoyId)
+  void Mouse_ApplyConfig(void)
   {
-    // FIXME: Deal with joystick emulation and autofire. See full function in Hatari src/joy.c.
-    uint8_t result = 0;
-    // Get the value of the GPIO port
-    uint8_t gpio_value = (nStJoyId == 0 ? PINB : PINC) & 0x3F;
-
-    // Arrange the bits in the order expected by the IKBD protocol.
-    if (!(gpio_value & GPIO_MASK_UP))    result |= ATARIJOY_BITMASK_UP;
-    if (!(gpio_value & GPIO_MASK_DOWN))  result |= ATARIJOY_BITMASK_DOWN;
-    if (!(gpio_value & GPIO_MASK_LEFT))  result |= ATARIJOY_BITMASK_LEFT;
-    if (!(gpio_value & GPIO_MASK_RIGHT)) result |= ATARIJOY_BITMASK_RIGHT;
-    if (!(gpio_value & GPIO_MASK_FIRE))  result |= ATARIJOY_BITMASK_FIRE;
-
-    return result;
+    // Sent from loop() once the mouse is done with any previous command.
+    mouse_config_pending = true;
   }
-}
 
+  void Keyboard_ApplyLeds(void)
+  {
 #if KEYBOARD_ENA
+    if (keyboard_started) PS2Keyboard::set_leds(KeyboardLeds.Leds);
+#endif
+  }
+}
 
-
+#if KEYBOARD_ENA
 void poll_keyboard()
 {
-  bool avail = false, buffer_overflow = false, leave_led_on = false;
-  static bool brk = false, extended = false, caps_lock_led = false;
+  static bool keys_lost = false;
+  bool avail = false, buffer_overflow = false;
   const uint8_t code = PS2Keyboard::read(&avail, &buffer_overflow);
-  if (buffer_overflow) leave_led_on = true;
+  // Bytes were dropped, maybe releases: once the ones that made it are
+  // decoded, release whatever is still down.
+  if (buffer_overflow) keys_lost = true;
+  // The same for a keyboard unplugged with keys down, which never sends
+  // their releases: check that it still answers while any are down.
+  static unsigned long ping_ms = 0;
+  if (IKBD_AnyKeyDown() && millis() - ping_ms >= KEYBOARD_PING_MS) {
+    ping_ms = millis();
+    PS2Keyboard::ping();
+  }
+  if (PS2Keyboard::lost()) keys_lost = true;
+  if (!avail && keys_lost) {
+    keys_lost = false;
+    input_keyboard_lost();
+  }
   if (avail) {
 #if DEBUG
     show_scan_code(code);
 #endif
     turn_LED_on();
-    if (code == 0xF0) brk = true;
-    else if (code == 0xE0) extended = true;
-    else if (code == 0xE1) { // Pause/Break handing
-      // E1 14 77 E1 F0 14 F0 77
-      // Eat the next seven bytes
-      int remaining = 7;
-
-      while (remaining) {
-        do {
-          PS2Keyboard::read(&avail, &buffer_overflow);
-        } while (!avail);
-        remaining--;
-      }
-      // This key press/release is completely ignored.
-    } else if (code != 0xAA) {
-      uint8_t st_scan_code = pgm_read_byte(&st_make_code_map[code]);
-      if (extended) st_scan_code = pgm_read_byte(&st_extended_make_code_map[code]);
-      IKBD_PressSTKey(st_scan_code, !brk);
-      if (code == 0x58 && !brk) { // caps lock
-        caps_lock_led = !caps_lock_led;
-        PS2Keyboard::set_caps_lock_led(caps_lock_led);
-      }
-      brk = false;
-      extended = false;
-    }
-    if (!leave_led_on) turn_LED_off();
+    input_keyboard_byte(code);
+    if (!buffer_overflow) turn_LED_off();
   }
 }
 #endif
 
 void poll_mouse()
 {
-  bool avail = false, buffer_overflow = false, leave_led_on = false;
-  const uint8_t mstat = PS2Mouse::read(&avail, &buffer_overflow);
-  if (buffer_overflow) leave_led_on = true;
-  if (avail) {
+  bool avail = false, buffer_overflow = false;
+  const uint8_t c = PS2Mouse::read(&avail, &buffer_overflow);
+  if (buffer_overflow) turn_LED_on();
+  if (!avail) return;
+  if (input_mouse_byte(c)) {
     turn_LED_on();
-    uint8_t dx8 = 0, dy8 = 0;
-    do {
-      dx8 = PS2Mouse::read(&avail, &buffer_overflow);
-      if (buffer_overflow) leave_led_on = true;
-    } while (!avail); // Keep attempting to read a byte while nothing available in the buffer.
-    do {
-      dy8 = PS2Mouse::read(&avail, &buffer_overflow);
-      if (buffer_overflow) leave_led_on = true;
-    } while (!avail);
-    unsigned int dx = dx8, dy = dy8;
-    if (mstat & X_SIGN) dx = 0xFF00 | dx8; /* sign extend */
-    if (mstat & Y_SIGN) dy = 0xFF00 | dy8;
-    KeyboardProcessor.Mouse.dx += (int) dx;
-    KeyboardProcessor.Mouse.dy += (int) dy;
-
-    if (mstat & RIGHT_BUTTON) Keyboard.bRButtonDown |= BUTTON_MOUSE;
-    else Keyboard.bRButtonDown &= ~BUTTON_MOUSE;
-
-    if (mstat & LEFT_BUTTON) Keyboard.bLButtonDown |= BUTTON_MOUSE;
-    else Keyboard.bLButtonDown &= ~BUTTON_MOUSE;
-
-    /* FIXME: Deal with mouse overflow bits. */
-    if (!leave_led_on) turn_LED_off();
+    if (!buffer_overflow) turn_LED_off();
   }
 }
 
 void loop() {
+  PROFILE_START(loop_start);
+  PROFILE_START(stage_start);
   bool avail = false;
   // See if there is an incoming command byte.
+  watchdog_check_in(WATCHDOG_COMMAND);
   const unsigned char c = recv_byte(&avail);
   if (avail) IKBD_RunKeyboardCommand(c);
+  PROFILE_STAGE(PROFILE_COMMAND, stage_start);
   // Next, we will check if there is keyboard or mouse activity.
-  poll_mouse();
+  watchdog_check_in(WATCHDOG_MOUSE);
+  if (mouse_started) poll_mouse();
+  PROFILE_STAGE(PROFILE_MOUSE, stage_start);
+  watchdog_check_in(WATCHDOG_KEYBOARD);
 #if KEYBOARD_ENA
-  poll_keyboard();
+  if (keyboard_started) poll_keyboard();
+#endif
+  PROFILE_STAGE(PROFILE_KEYBOARD, stage_start);
+  watchdog_check_in(WATCHDOG_CONFIG);
+  const unsigned long now = millis();
+  // Back off when the host link can't keep up.
+  if (rate_control_update(now, Keyboard.NbBytesInOutputBuffer)) mouse_config_pending = true;
+#if MOUSE_ENA
+  if (mouse_config_pending && mouse_started) {
+    mouse_config_pending = !PS2Mouse::configure(rate_control_mouse_rate(MouseConfig.SampleRate),
+                                                MouseConfig.Resolution, MouseConfig.Scaling,
+                                                MouseConfig.RemoteMode);
+  }
+#endif
+  PROFILE_STAGE(PROFILE_CONFIG, stage_start);
+  // Generate the automatic reports once per report tick.
+  watchdog_check_in(WATCHDOG_REPORT);
+  static unsigned long last_report_ms = 0;
+  if (now - last_report_ms >= rate_control_report_interval()) {
+    last_report_ms = now;
+    IKBD_SendAutoKeyboardCommands();
+#if MOUSE_ENA
+    // In remote mode, the movement read now is reported on the next tick.
+    if (MouseConfig.RemoteMode) PS2Mouse::request_data();
 #endif
+  }
+  PROFILE_STAGE(PROFILE_REPORT, stage_start);
   // See if the IKBD has any response.
-  IKBD_SendAutoKeyboardCommands();
+  watchdog_check_in(WATCHDOG_OUTPUT);
   check_ikbd_output_buffer();
+  PROFILE_STAGE(PROFILE_OUTPUT, stage_start);
+  // Play queued macros, and write back changed settings a byte at a time.
+  watchdog_check_in(WATCHDOG_SAVE);
+  remap_poll();
+  settings_poll();
+  snapshot_poll();
+  watchdog_poll();
+  PROFILE_STAGE(PROFILE_LOOP, loop_start);
 }
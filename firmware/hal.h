@@ -0,0 +1,83 @@
+// hal.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// Thin hardware abstraction used by the IKBD engine, so that it can be
+// built both for the ATmega328P (hal_avr.cpp) and for the host against
+// in-memory fakes (host/hal_fake.c). The serial link is behind util.h.
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef KEMOJO_HOST
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define PGM_P const char *
+#define HAL_NOINIT
+#else
+#include <avr/pgmspace.h>
+// Left alone by the C startup code, so that it keeps its value across a
+// reset without power loss.
+#define HAL_NOINIT __attribute__((section(".noinit")))
+#endif
+
+// The IKBD reset timer fires this long after hal_reset_timer_start().
+#define HAL_RESET_TIMER_MS 63
+
+// Reset causes, as in the AVR's MCUSR.
+#define HAL_RESET_POWER_ON 0x01
+#define HAL_RESET_EXTERNAL 0x02
+#define HAL_RESET_BROWN_OUT 0x04
+#define HAL_RESET_WATCHDOG 0x08
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Configure the debug LED and joystick port pins.
+void hal_init(void);
+
+// Why the MCU last reset, HAL_RESET_xxx bits. 0 if a bootloader cleared
+// them before us.
+uint8_t hal_reset_cause(void);
+
+// Milliseconds since power up.
+uint32_t hal_millis(void);
+
+// Debug LED.
+void hal_led(bool on);
+
+// Raw state of joystick port 0 or 1: bits 5:0, active low (see GPIO_MASK_xxx).
+uint8_t hal_joystick_read(int port);
+
+// One-shot timer calling IKBD_InterruptHandler_ResetTimer() on expiry.
+void hal_reset_timer_start(void);
+void hal_reset_timer_stop(void);
+
+// Watchdog: resets the MCU, cause HAL_RESET_WATCHDOG, unless kicked at
+// least every 'ms' (rounded up to 15 ms times a power of 2, at most 8 s).
+// A watchdog reset leaves it off.
+void hal_watchdog_start(uint16_t ms);
+void hal_watchdog_kick(void);
+
+long hal_random(void);
+
+// Mask interrupts around data shared with interrupt handlers, and put
+// them back as they were.
+uint8_t hal_irq_save(void);
+void hal_irq_restore(uint8_t state);
+
+// EEPROM (see eeprom_map.h). A write takes about 3.4 ms, during which the
+// EEPROM isn't ready: hal_eeprom_write() may only be called when it is.
+uint8_t hal_eeprom_read(uint16_t addr);
+bool hal_eeprom_ready(void);
+void hal_eeprom_write(uint16_t addr, uint8_t value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HAL_H
@@ -0,0 +1,144 @@
+// hal_avr.cpp
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#include "hal.h"
+#include "ikbd.h"
+#include "profile.h"
+
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <avr/wdt.h>
+
+static uint8_t g_reset_cause HAL_NOINIT;
+
+// Runs before the C startup code: after a watchdog reset the watchdog is
+// still on at 15 ms, too short to get to setup().
+extern "C" void hal_early_init(void) __attribute__((naked, used, section(".init3")));
+void hal_early_init(void)
+{
+    g_reset_cause = MCUSR;
+    MCUSR = 0;
+    wdt_disable();
+}
+
+void hal_init(void)
+{
+    // Configure the debug LED pin as output
+    pinMode(PIN7, OUTPUT);
+
+    // Set up the joystick ports by setting bits 5:0 of ports B and C to inputs.
+    DDRB = DDRB & 0xC0;
+    DDRC = DDRC & 0xC0;
+    // And pull them up.
+    PORTB = PORTB | 0x3F;
+    PORTC = PORTC | 0x3F;
+}
+
+uint8_t hal_reset_cause(void)
+{
+    return g_reset_cause;
+}
+
+uint32_t hal_millis(void)
+{
+    return millis();
+}
+
+void hal_led(const bool on)
+{
+    // The LED is lit when the pin is low.
+    digitalWrite(PIN7, on ? LOW : HIGH);
+}
+
+uint8_t hal_joystick_read(const int port)
+{
+    return (port == 0 ? PINB : PINC) & 0x3F;
+}
+
+void hal_reset_timer_start(void)
+{
+    // Configure Timer1 to interrupt in 1/16 of a second.
+    noInterrupts();           // Disable interrupts during setup
+
+    // Clear Timer1 control registers
+    TCCR1A = 0;
+    TCCR1B = 0;
+    TCNT1 = 0;               // Initialize counter
+
+    // Set compare match register for 1Hz increments
+    // 16MHz Arduino clock / 256 prescaler / 16Hz = 3906
+    // 7372800 Hz Arduino clock / 256 prescaral / 16 Hz =
+    /* OCR1A = 3906; *//* Perhaps should calc based on IKBD_RESET_CYCLES */
+    OCR1A = 1800;
+    // Turn on CTC mode (Clear Timer on Compare Match)
+    TCCR1B |= (1 << WGM12);
+
+    // Set prescaler to 256
+    TCCR1B |= (1 << CS12);
+
+    // Enable timer compare interrupt
+    TIMSK1 |= (1 << OCIE1A);
+
+    interrupts();            // Enable interrupts
+}
+
+void hal_reset_timer_stop(void)
+{
+    TIMSK1 &= ~(1 << OCIE1A);
+}
+
+void hal_watchdog_start(const uint16_t ms)
+{
+    uint8_t period = WDTO_15MS;
+    while (period < WDTO_8S && (15UL << period) < ms)
+        period++;
+    wdt_enable(period);
+}
+
+void hal_watchdog_kick(void)
+{
+    wdt_reset();
+}
+
+ISR(TIMER1_COMPA_vect)
+{
+    PROFILE_ISR_ENTER(entered);
+    /* We are using the timer as a one shot, so turn off its interrupt. */
+    TIMSK1 &= ~(1 << OCIE1A);
+    IKBD_InterruptHandler_ResetTimer();
+    PROFILE_ISR_EXIT(PROFILE_ISR_RESET_TIMER, entered);
+}
+
+long hal_random(void)
+{
+    return random();
+}
+
+uint8_t hal_irq_save(void)
+{
+    const uint8_t state = SREG;
+    cli();
+    return state;
+}
+
+void hal_irq_restore(const uint8_t state)
+{
+    SREG = state;
+}
+
+uint8_t hal_eeprom_read(const uint16_t addr)
+{
+    return eeprom_read_byte((const uint8_t *)addr);
+}
+
+bool hal_eeprom_ready(void)
+{
+    return eeprom_is_ready();
+}
+
+void hal_eeprom_write(const uint16_t addr, const uint8_t value)
+{
+    // Starts the write and returns, as the EEPROM is ready.
+    eeprom_write_byte((uint8_t *)addr, value);
+}
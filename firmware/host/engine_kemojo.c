@@ -0,0 +1,125 @@
+// engine_kemojo.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// Our IKBD engine for ikbd_replay, run the way firmware.ino runs it.
+
+#include "replay.h"
+
+#include "config.h"
+#include "hal.h"
+#include "hal_fake.h"
+#include "ikbd.h"
+#include "input.h"
+#include "joy.h"
+#include "remap.h"
+#include "settings.h"
+#include "snapshot.h"
+#include "watchdog.h"
+
+const char *const engine_name = "kemojo";
+
+static uint32_t g_us, g_next_report_us;
+
+static void boot(void)
+{
+    watchdog_begin();
+    settings_boot();
+    remap_load();
+    if (hal_reset_cause() & HAL_RESET_POWER_ON)
+        IKBD_Reset(true);
+    else
+        IKBD_MemorySnapShot_Capture(false);
+    watchdog_run();
+}
+
+void engine_init(void)
+{
+    hal_fake_reset();
+    g_us = 0;
+    g_next_report_us = IKBD_REPORT_INTERVAL_MS * 1000;
+    boot();
+}
+
+bool engine_restart(const uint8_t cause)
+{
+    hal_fake_restart(cause);
+    boot();
+    return true;
+}
+
+void engine_advance_us(const uint32_t us)
+{
+    const uint32_t end = g_us + us;
+    while (g_us < end) {
+        // The HAL fakes count in milliseconds.
+        const uint32_t next_ms = (g_us / 1000 + 1) * 1000;
+        const uint32_t step_to = next_ms < end ? next_ms : end;
+        if (step_to / 1000 != g_us / 1000) {
+            hal_fake_advance_ms(1);
+            watchdog_check_in(WATCHDOG_SAVE);
+            remap_poll();
+            settings_poll();
+            snapshot_poll();
+            watchdog_poll();
+        }
+        g_us = step_to;
+        if (g_us >= g_next_report_us) {
+            watchdog_check_in(WATCHDOG_REPORT);
+            IKBD_SendAutoKeyboardCommands();
+            g_next_report_us += IKBD_REPORT_INTERVAL_MS * 1000;
+        }
+    }
+}
+
+void engine_host_byte(const uint8_t c)
+{
+    watchdog_check_in(WATCHDOG_COMMAND);
+    IKBD_RunKeyboardCommand(c);
+}
+
+void engine_key(const uint8_t st_scan_code, const bool press)
+{
+    IKBD_PressSTKey(st_scan_code, press);
+}
+
+void engine_mouse(const int dx, const int dy, const bool left, const bool right)
+{
+    KeyboardProcessor.Mouse.dx += dx;
+    KeyboardProcessor.Mouse.dy += dy;
+    IKBD_SetMouseButtons(left, right);
+}
+
+void engine_joystick(const int port, const uint8_t st_bits)
+{
+    // Back to active low port pins.
+    uint8_t gpio = 0x3f;
+    if (st_bits & ATARIJOY_BITMASK_UP)    gpio &= ~GPIO_MASK_UP;
+    if (st_bits & ATARIJOY_BITMASK_DOWN)  gpio &= ~GPIO_MASK_DOWN;
+    if (st_bits & ATARIJOY_BITMASK_LEFT)  gpio &= ~GPIO_MASK_LEFT;
+    if (st_bits & ATARIJOY_BITMASK_RIGHT) gpio &= ~GPIO_MASK_RIGHT;
+    if (st_bits & ATARIJOY_BITMASK_FIRE)  gpio &= ~GPIO_MASK_FIRE;
+    hal_fake_set_joystick(port & 1, gpio);
+}
+
+bool engine_ps2_keyboard(const uint8_t c)
+{
+    input_keyboard_byte(c);
+    return true;
+}
+
+bool engine_ps2_mouse(const uint8_t c)
+{
+    input_mouse_byte(c);
+    return true;
+}
+
+int engine_pop_output(void)
+{
+    if (Keyboard.NbBytesInOutputBuffer == 0 || Keyboard.PauseOutput)
+        return -1;
+    const uint8_t c = Keyboard.Buffer[Keyboard.BufferHead++];
+    Keyboard.BufferHead &= KEYBOARD_BUFFER_MASK;
+    Keyboard.NbBytesInOutputBuffer--;
+    return c;
+}
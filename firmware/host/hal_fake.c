@@ -0,0 +1,214 @@
+// hal_fake.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#include "hal_fake.h"
+#include "eeprom_map.h"
+#include "hal.h"
+#include "ikbd.h"
+
+#define UART_QUEUE_SIZE 1024
+#define UART_QUEUE_MASK (UART_QUEUE_SIZE - 1)
+
+typedef struct {
+    uint8_t data[UART_QUEUE_SIZE];
+    unsigned head, tail;
+} uart_queue_t;
+
+static uint32_t g_now_ms;
+static bool g_led;
+static uint8_t g_joystick[2];
+static uint8_t g_reset_cause;
+static bool g_reset_timer_armed;
+static uint32_t g_reset_timer_ms;
+static uart_queue_t g_rx, g_tx;
+static unsigned long g_random_state;
+// Keeps its contents across hal_fake_reset(), like the real one.
+static uint8_t g_eeprom[EEPROM_SIZE];
+static bool g_eeprom_erased;
+
+unsigned hal_fake_mouse_config_count;
+unsigned hal_fake_keyboard_leds_count;
+unsigned hal_fake_eeprom_writes;
+
+static void queue_push(uart_queue_t *q, const uint8_t c)
+{
+    // Drop the byte when full, like a UART overrun.
+    if (((q->tail + 1) & UART_QUEUE_MASK) == q->head)
+        return;
+    q->data[q->tail] = c;
+    q->tail = (q->tail + 1) & UART_QUEUE_MASK;
+}
+
+static int queue_pop(uart_queue_t *q)
+{
+    if (q->head == q->tail)
+        return -1;
+    const uint8_t c = q->data[q->head];
+    q->head = (q->head + 1) & UART_QUEUE_MASK;
+    return c;
+}
+
+void hal_fake_reset(void)
+{
+    g_now_ms = 0;
+    g_reset_cause = HAL_RESET_POWER_ON;
+    g_led = false;
+    g_joystick[0] = g_joystick[1] = 0x3F;
+    g_reset_timer_armed = false;
+    g_rx.head = g_rx.tail = 0;
+    g_tx.head = g_tx.tail = 0;
+    g_random_state = 1;
+    hal_fake_mouse_config_count = 0;
+    hal_fake_keyboard_leds_count = 0;
+}
+
+void hal_fake_advance_ms(const uint32_t ms)
+{
+    g_now_ms += ms;
+    if (g_reset_timer_armed && (int32_t)(g_now_ms - g_reset_timer_ms) >= 0) {
+        g_reset_timer_armed = false;
+        IKBD_InterruptHandler_ResetTimer();
+    }
+}
+
+void hal_fake_restart(const uint8_t cause)
+{
+    g_reset_cause = cause;
+    g_reset_timer_armed = false;
+}
+
+void hal_fake_set_joystick(const int port, const uint8_t gpio_value)
+{
+    g_joystick[port ? 1 : 0] = gpio_value & 0x3F;
+}
+
+bool hal_fake_led(void)
+{
+    return g_led;
+}
+
+void hal_fake_uart_push_rx(const uint8_t c)
+{
+    queue_push(&g_rx, c);
+}
+
+int hal_fake_uart_pop_tx(void)
+{
+    return queue_pop(&g_tx);
+}
+
+int hal_fake_uart_pop_rx(void)
+{
+    return queue_pop(&g_rx);
+}
+
+void hal_fake_uart_push_tx(const uint8_t c)
+{
+    queue_push(&g_tx, c);
+}
+
+void hal_fake_eeprom_erase(void)
+{
+    for (unsigned i = 0; i < EEPROM_SIZE; i++)
+        g_eeprom[i] = 0xFF;
+    g_eeprom_erased = true;
+    hal_fake_eeprom_writes = 0;
+}
+
+/* hal.h */
+
+void hal_init(void)
+{
+}
+
+uint8_t hal_reset_cause(void)
+{
+    return g_reset_cause;
+}
+
+uint32_t hal_millis(void)
+{
+    return g_now_ms;
+}
+
+void hal_led(const bool on)
+{
+    g_led = on;
+}
+
+uint8_t hal_joystick_read(const int port)
+{
+    return g_joystick[port ? 1 : 0];
+}
+
+void hal_reset_timer_start(void)
+{
+    g_reset_timer_armed = true;
+    g_reset_timer_ms = g_now_ms + HAL_RESET_TIMER_MS;
+}
+
+void hal_reset_timer_stop(void)
+{
+    g_reset_timer_armed = false;
+}
+
+// Nothing on the host hangs in a way the watchdog could catch.
+void hal_watchdog_start(const uint16_t ms)
+{
+    (void)ms;
+}
+
+void hal_watchdog_kick(void)
+{
+}
+
+long hal_random(void)
+{
+    // Deterministic, so that runs can be compared byte for byte.
+    g_random_state = g_random_state * 1103515245UL + 12345UL;
+    return (long)((g_random_state >> 1) & 0x7FFFFFFFUL);
+}
+
+uint8_t hal_irq_save(void)
+{
+    // No interrupts on the host.
+    return 0;
+}
+
+void hal_irq_restore(const uint8_t state)
+{
+    (void)state;
+}
+
+uint8_t hal_eeprom_read(const uint16_t addr)
+{
+    if (!g_eeprom_erased)
+        hal_fake_eeprom_erase();
+    return g_eeprom[addr % EEPROM_SIZE];
+}
+
+bool hal_eeprom_ready(void)
+{
+    return true;
+}
+
+void hal_eeprom_write(const uint16_t addr, const uint8_t value)
+{
+    if (!g_eeprom_erased)
+        hal_fake_eeprom_erase();
+    g_eeprom[addr % EEPROM_SIZE] = value;
+    hal_fake_eeprom_writes++;
+}
+
+/* Device hooks from ikbd.h, normally provided by firmware.ino */
+
+void Mouse_ApplyConfig(void)
+{
+    hal_fake_mouse_config_count++;
+}
+
+void Keyboard_ApplyLeds(void)
+{
+    hal_fake_keyboard_leds_count++;
+}
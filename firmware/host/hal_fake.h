@@ -0,0 +1,54 @@
+// hal_fake.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// In-memory fakes of the HAL (hal.h) and serial link (util.h) for host
+// builds. Time only moves when the caller advances it.
+
+#ifndef HAL_FAKE_H
+#define HAL_FAKE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Back to power-up state: time 0, joysticks released, empty UART queues.
+void hal_fake_reset(void);
+
+// A reset without power loss, for hal_reset_cause(): RAM, time and the
+// UART queues are kept.
+void hal_fake_restart(uint8_t cause);
+
+// Advance time, firing the reset timer when it expires.
+void hal_fake_advance_ms(uint32_t ms);
+
+// Raw port value, bits 5:0 active low. 0x3F means nothing pressed.
+void hal_fake_set_joystick(int port, uint8_t gpio_value);
+
+bool hal_fake_led(void);
+
+// Bytes sent by the host to KEMOJO.
+void hal_fake_uart_push_rx(uint8_t c);
+// Next byte sent by KEMOJO to the host, or -1.
+int hal_fake_uart_pop_tx(void);
+
+// Used by the host version of util.cpp.
+int hal_fake_uart_pop_rx(void);
+void hal_fake_uart_push_tx(uint8_t c);
+
+// Number of calls to Mouse_ApplyConfig() and Keyboard_ApplyLeds().
+extern unsigned hal_fake_mouse_config_count;
+extern unsigned hal_fake_keyboard_leds_count;
+
+// The EEPROM starts erased and keeps its contents across hal_fake_reset().
+void hal_fake_eeprom_erase(void);
+extern unsigned hal_fake_eeprom_writes;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HAL_FAKE_H
@@ -0,0 +1,186 @@
+// engine_hatari.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// Hatari's own IKBD model (src/ikbd.c from a Hatari 2.x source tree) as an
+// ikbd_replay engine, the reference KEMOJO is checked against. ikbd.c is
+// included whole so its static command and receive functions can be
+// reached; what it needs from the rest of the emulator is stubbed here.
+// Other Hatari releases may call a few more functions: the linker names
+// them, and they get an empty stub below.
+//
+// Hatari's CPU clock is the ST's 8021247 Hz. Its cycle interrupts are run
+// from engine_advance_us() in that time base.
+
+#include HATARI_IKBD_C
+
+#include "../replay.h"
+
+const char *const engine_name = "hatari";
+
+#define ST_CPU_FREQ 8021247ull
+
+// Cycle interrupts -----------------------------------------------------------
+
+typedef struct {
+    bool active;
+    uint64_t due;
+} pending_t;
+
+static pending_t g_pending[MAX_INTERRUPTS];
+static uint64_t g_cycles;
+static interrupt_id g_running;
+
+static uint64_t to_cpu_cycles(const int cycle_time, const int cycle_type)
+{
+    // INT_CPU8_CYCLE counts at 8 MHz, INT_CPU_CYCLE at the CPU clock, which
+    // is the same with an ST's 68000.
+    (void)cycle_type;
+    return cycle_time > 0 ? (uint64_t)cycle_time : 0;
+}
+
+void CycInt_AddRelativeInterrupt(const int CycleTime, const int CycleType, const interrupt_id Handler)
+{
+    g_pending[Handler].active = true;
+    g_pending[Handler].due = g_cycles + to_cpu_cycles(CycleTime, CycleType);
+}
+
+void CycInt_AddAbsoluteInterrupt(const int CycleTime, const int CycleType, const interrupt_id Handler)
+{
+    CycInt_AddRelativeInterrupt(CycleTime, CycleType, Handler);
+}
+
+void CycInt_RemovePendingInterrupt(const interrupt_id Handler)
+{
+    g_pending[Handler].active = false;
+}
+
+void CycInt_AcknowledgeInterrupt(void)
+{
+    g_pending[g_running].active = false;
+}
+
+bool CycInt_InterruptActive(const interrupt_id Handler)
+{
+    return g_pending[Handler].active;
+}
+
+static void run_interrupts(void)
+{
+    for (bool fired = true; fired;) {
+        fired = false;
+        for (int i = 0; i < MAX_INTERRUPTS; i++) {
+            if (!g_pending[i].active || g_pending[i].due > g_cycles)
+                continue;
+            g_running = (interrupt_id)i;
+            if (i == INTERRUPT_IKBD_RESETTIMER)
+                IKBD_InterruptHandler_ResetTimer();
+            else if (i == INTERRUPT_IKBD_AUTOSEND)
+                IKBD_InterruptHandler_AutoSend();
+            g_pending[i].active = false;
+            fired = true;
+        }
+    }
+}
+
+// The rest of the emulator ---------------------------------------------------
+
+CNF_PARAMS ConfigureParams;
+ACIA_STRUCT ACIA_Array[ACIA_MAX_NB];
+ACIA_STRUCT *pACIA_IKBD = &ACIA_Array[0];
+uint64_t LogTraceFlags;
+
+static uint8_t g_joystick[2];
+
+uint8_t Joy_GetStickData(const int nStJoyId)
+{
+    return g_joystick[nStJoyId & 1];
+}
+
+void Log_Printf(const LOGTYPE nType, const char *psFormat, ...)
+{
+    (void)nType;
+    (void)psFormat;
+}
+
+void MemorySnapShot_Store(void *pData, const int Size)
+{
+    (void)pData;
+    (void)Size;
+}
+
+// Engine ---------------------------------------------------------------------
+
+void engine_init(void)
+{
+    memset(g_pending, 0, sizeof(g_pending));
+    memset(g_joystick, 0, sizeof(g_joystick));
+    g_cycles = 0;
+    IKBD_Init();
+    IKBD_Reset(true);
+    run_interrupts();
+}
+
+void engine_advance_us(const uint32_t us)
+{
+    g_cycles += us * ST_CPU_FREQ / 1000000;
+    run_interrupts();
+}
+
+void engine_host_byte(const uint8_t c)
+{
+    IKBD_Process_RDR(c);
+    run_interrupts();
+}
+
+void engine_key(const uint8_t st_scan_code, const bool press)
+{
+    IKBD_PressSTKey(st_scan_code, press);
+}
+
+void engine_mouse(const int dx, const int dy, const bool left, const bool right)
+{
+    KeyboardProcessor.Mouse.dx += dx;
+    KeyboardProcessor.Mouse.dy += dy;
+    if (left)
+        Keyboard.bLButtonDown |= BUTTON_MOUSE;
+    else
+        Keyboard.bLButtonDown &= ~BUTTON_MOUSE;
+    if (right)
+        Keyboard.bRButtonDown |= BUTTON_MOUSE;
+    else
+        Keyboard.bRButtonDown &= ~BUTTON_MOUSE;
+}
+
+void engine_joystick(const int port, const uint8_t st_bits)
+{
+    g_joystick[port & 1] = st_bits;
+}
+
+bool engine_restart(const uint8_t cause)
+{
+    (void)cause;
+    return false;
+}
+
+bool engine_ps2_keyboard(const uint8_t c)
+{
+    (void)c;
+    return false;
+}
+
+bool engine_ps2_mouse(const uint8_t c)
+{
+    (void)c;
+    return false;
+}
+
+int engine_pop_output(void)
+{
+    if (Keyboard.NbBytesInOutputBuffer == 0 || Keyboard.PauseOutput)
+        return -1;
+    const uint8_t c = Keyboard.Buffer[Keyboard.BufferHead++];
+    Keyboard.BufferHead &= KEYBOARD_BUFFER_MASK;
+    Keyboard.NbBytesInOutputBuffer--;
+    return c;
+}
@@ -0,0 +1,121 @@
+// ikbd_bench.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// Micro-benchmarks of the IKBD engine on the host, against the HAL fakes.
+// Usage: ikbd_bench [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "hal.h"
+#include "hal_fake.h"
+#include "ikbd.h"
+#include "util.h"
+
+static unsigned long g_bytes_out;
+
+// Same as check_ikbd_output_buffer() in firmware.ino, but drains everything.
+static void drain_output(void)
+{
+    while (Keyboard.NbBytesInOutputBuffer > 0 && !Keyboard.PauseOutput) {
+        const uint8_t ch = Keyboard.Buffer[Keyboard.BufferHead++];
+        Keyboard.BufferHead &= KEYBOARD_BUFFER_MASK;
+        Keyboard.NbBytesInOutputBuffer--;
+        hal_fake_uart_push_tx(ch);
+        g_bytes_out++;
+    }
+    while (hal_fake_uart_pop_tx() >= 0)
+        ;
+}
+
+static void boot(void)
+{
+    hal_fake_reset();
+    IKBD_Reset(true);
+    hal_fake_advance_ms(HAL_RESET_TIMER_MS);
+    drain_output();
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench_commands(const unsigned long n)
+{
+    // Report mouse threshold: one command byte in, eight bytes out.
+    for (unsigned long i = 0; i < n; i++) {
+        IKBD_RunKeyboardCommand(0x8B);
+        drain_output();
+    }
+}
+
+static void bench_keys(const unsigned long n)
+{
+    for (unsigned long i = 0; i < n; i++) {
+        IKBD_PressSTKey(0x1E, true);
+        IKBD_PressSTKey(0x1E, false);
+        drain_output();
+    }
+}
+
+static void bench_rel_mouse(const unsigned long n)
+{
+    for (unsigned long i = 0; i < n; i++) {
+        KeyboardProcessor.Mouse.dx += (i & 1) ? 300 : -300;
+        KeyboardProcessor.Mouse.dy += 5;
+        Keyboard.bLButtonDown = (i & 2) ? BUTTON_MOUSE : BUTTON_NULL;
+        IKBD_SendAutoKeyboardCommands();
+        drain_output();
+    }
+}
+
+static void bench_abs_mouse(const unsigned long n)
+{
+    static const uint8_t abs_mode[] = { 0x09, 0x02, 0x7F, 0x01, 0x8F };
+    for (unsigned i = 0; i < sizeof(abs_mode); i++)
+        IKBD_RunKeyboardCommand(abs_mode[i]);
+    for (unsigned long i = 0; i < n; i++) {
+        KeyboardProcessor.Mouse.dx += (i & 1) ? 7 : -3;
+        KeyboardProcessor.Mouse.dy += (i & 1) ? -2 : 4;
+        IKBD_SendAutoKeyboardCommands();
+        IKBD_RunKeyboardCommand(0x0D);
+        drain_output();
+    }
+}
+
+static void bench_joystick(const unsigned long n)
+{
+    IKBD_RunKeyboardCommand(0x14);
+    for (unsigned long i = 0; i < n; i++) {
+        hal_fake_set_joystick(1, (i & 1) ? 0x3F : 0x1F);
+        IKBD_SendAutoKeyboardCommands();
+        drain_output();
+    }
+}
+
+static void run(const char *name, void (*bench)(unsigned long), const unsigned long n)
+{
+    boot();
+    g_bytes_out = 0;
+    const double start = now_ns();
+    bench(n);
+    const double elapsed = now_ns() - start;
+    printf("%-16s %10.1f ns/op %8.2f bytes/op\n", name, elapsed / n, (double)g_bytes_out / n);
+}
+
+int main(int argc, char **argv)
+{
+    const unsigned long n = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000000;
+
+    run("commands", bench_commands, n);
+    run("keys", bench_keys, n);
+    run("rel_mouse", bench_rel_mouse, n);
+    run("abs_mouse", bench_abs_mouse, n);
+    run("joystick", bench_joystick, n);
+    return 0;
+}
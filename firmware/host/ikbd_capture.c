@@ -0,0 +1,162 @@
+// ikbd_capture.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// Turns the inputs drained with IKBD command 0xB5 (CAPTURE_ENA) from a
+// capture of the IKBD's output (see ring_reader.h) into a script that plays
+// them again: for ikbd_replay on the host build, or with -s for ikbd_sim on
+// the firmware under simavr. Times are kept as recorded, in ms since power
+// up, so a capture that starts there replays from the same state.
+//
+// ikbd_replay gets the PS/2 bytes as they were read. ikbd_sim gets the
+// keyboard bytes the same way, and the mouse as the packets it decoded.
+//
+// Usage: ikbd_capture [-x] [-s] [capture] > script
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "capture.h"
+#include "ikbd.h"
+#include "joy.h"
+#include "ring_reader.h"
+
+typedef struct {
+    bool sim;
+    // Time stamps are 16 bits: count their wraps.
+    uint32_t wraps;
+    uint16_t prev_ms;
+    unsigned inputs;
+    // Line being built, so that bytes read in the same ms share one.
+    int line_source;
+    uint32_t line_ms;
+    uint32_t last_ms;
+    // ikbd_sim mouse packet.
+    uint8_t packet[3];
+    unsigned packet_len;
+} converter_t;
+
+static void end_line(converter_t *cv)
+{
+    if (cv->line_source >= 0)
+        printf("\n");
+    cv->line_source = -1;
+}
+
+// Byte of a line of bytes: host, ps2key, ps2mouse (sim: key, host).
+static void add_byte(converter_t *cv, const int source, const uint32_t ms, const uint8_t c)
+{
+    if (source != cv->line_source || ms != cv->line_ms) {
+        static const char *const replay_names[] = { "host", "ps2key", "ps2mouse" };
+        static const char *const sim_names[] = { "host", "key", "mouse" };
+        end_line(cv);
+        printf("%u %s", ms, (cv->sim ? sim_names : replay_names)[source]);
+        cv->line_source = source;
+        cv->line_ms = ms;
+    }
+    printf(" %02X", c);
+}
+
+static void sim_mouse_byte(converter_t *cv, const uint32_t ms, const uint8_t c)
+{
+    // Same framing as input_mouse_byte(), less the timeout.
+    if (cv->packet_len == 0 && !(c & 0x08))
+        return;
+    cv->packet[cv->packet_len++] = c;
+    if (cv->packet_len < 3)
+        return;
+    cv->packet_len = 0;
+    const int dx = cv->packet[1] - (cv->packet[0] & 0x10 ? 256 : 0);
+    const int dy = cv->packet[2] - (cv->packet[0] & 0x20 ? 256 : 0);
+    end_line(cv);
+    printf("%u mouse %d %d %d\n", ms, dx, dy, cv->packet[0] & 0x07);
+}
+
+static void joystick(converter_t *cv, uint32_t ms, const int port, const uint8_t gpio)
+{
+    // Pins are recorded when the firmware reads them, so they changed
+    // before that: set them a ms earlier, keeping the lines in order.
+    if (ms > cv->last_ms)
+        ms--;
+    cv->last_ms = ms;
+    end_line(cv);
+    if (cv->sim) {
+        printf("%u joy %d %02X\n", ms, port, gpio);
+        return;
+    }
+    uint8_t st = 0;
+    if (!(gpio & GPIO_MASK_UP))    st |= ATARIJOY_BITMASK_UP;
+    if (!(gpio & GPIO_MASK_DOWN))  st |= ATARIJOY_BITMASK_DOWN;
+    if (!(gpio & GPIO_MASK_LEFT))  st |= ATARIJOY_BITMASK_LEFT;
+    if (!(gpio & GPIO_MASK_RIGHT)) st |= ATARIJOY_BITMASK_RIGHT;
+    if (!(gpio & GPIO_MASK_FIRE))  st |= ATARIJOY_BITMASK_FIRE;
+    printf("%u joy %d %02X\n", ms, port, st);
+}
+
+static void convert_block(const uint8_t *entries, const unsigned count, const unsigned lost, void *param)
+{
+    converter_t *cv = param;
+    if (lost) {
+        end_line(cv);
+        printf("# %u inputs lost\n", lost);
+    }
+    for (unsigned i = 0; i < count; i++) {
+        const uint8_t *e = entries + i * CAPTURE_ENTRY_SIZE;
+        const uint16_t t = e[0] << 8 | e[1];
+        if (cv->inputs++ && t < cv->prev_ms)
+            cv->wraps++;
+        cv->prev_ms = t;
+        const uint32_t ms = cv->wraps << 16 | t;
+        switch (e[2]) {
+        case CAPTURE_HOST:
+        case CAPTURE_KEYBOARD:
+            add_byte(cv, e[2], ms, e[3]);
+            break;
+        case CAPTURE_MOUSE:
+            if (cv->sim)
+                sim_mouse_byte(cv, ms, e[3]);
+            else
+                add_byte(cv, e[2], ms, e[3]);
+            break;
+        case CAPTURE_JOYSTICK0:
+        case CAPTURE_JOYSTICK1:
+            joystick(cv, ms, e[2] - CAPTURE_JOYSTICK0, e[3]);
+            break;
+        default:
+            end_line(cv);
+            printf("# unknown source %u\n", e[2]);
+            break;
+        }
+        if (e[2] != CAPTURE_JOYSTICK0 && e[2] != CAPTURE_JOYSTICK1)
+            cv->last_ms = ms;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    converter_t cv = { .line_source = -1 };
+    bool hex = false;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1]; arg++) {
+        if (strcmp(argv[arg], "-x") == 0)
+            hex = true;
+        else if (strcmp(argv[arg], "-s") == 0)
+            cv.sim = true;
+        else
+            break;
+    }
+    if (argc - arg > 1 || (arg < argc && argv[arg][0] == '-')) {
+        fprintf(stderr, "usage: %s [-x] [-s] [capture]\n", argv[0]);
+        return 2;
+    }
+    ring_capture_t cap;
+    ring_capture_load(&cap, arg < argc ? argv[arg] : NULL, hex);
+    printf("# inputs captured by KEMOJO, for %s\n", cv.sim ? "ikbd_sim" : "ikbd_replay");
+    const unsigned blocks =
+        ring_capture_read(&cap, 0x35, CAPTURE_ENTRY_SIZE, CAPTURE_RING_SIZE, convert_block, &cv);
+    end_line(&cv);
+    ring_capture_free(&cap);
+    return blocks ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+// ikbd_diff.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// Compares two ikbd_replay outputs: the same bytes in the same order, each
+// sent within a tolerance of the other. Exits with 1 if they differ.
+//
+// Usage: ikbd_diff [-t ms] a.out b.out
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Differences reported in full before only being counted.
+#define MAX_REPORTED 10
+
+typedef struct {
+    double ms;
+    unsigned c;
+} byte_t;
+
+typedef struct {
+    char title[256];
+    byte_t *bytes;
+    unsigned count, capacity;
+} stream_t;
+
+static void load(stream_t *s, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        exit(2);
+    }
+    *s = (stream_t){ 0 };
+    snprintf(s->title, sizeof(s->title), "%s", path);
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#') {
+            // Header written by ikbd_replay: engine and script.
+            if (s->count == 0 && line[1] == ' ')
+                snprintf(s->title, sizeof(s->title), "%s", line + 2);
+            continue;
+        }
+        byte_t b;
+        if (sscanf(line, "%lf %x", &b.ms, &b.c) != 2)
+            continue;
+        if (s->count == s->capacity) {
+            s->capacity = s->capacity ? s->capacity * 2 : 1024;
+            s->bytes = realloc(s->bytes, s->capacity * sizeof(*s->bytes));
+            if (!s->bytes)
+                abort();
+        }
+        s->bytes[s->count++] = b;
+    }
+    s->title[strcspn(s->title, "\r\n")] = '\0';
+    fclose(f);
+}
+
+int main(int argc, char **argv)
+{
+    double tolerance_ms = 20;
+    int arg = 1;
+    if (arg + 1 < argc && strcmp(argv[arg], "-t") == 0) {
+        tolerance_ms = strtod(argv[arg + 1], NULL);
+        arg += 2;
+    }
+    if (argc - arg != 2) {
+        fprintf(stderr, "usage: %s [-t ms] a.out b.out\n", argv[0]);
+        return 2;
+    }
+
+    stream_t a, b;
+    load(&a, argv[arg]);
+    load(&b, argv[arg + 1]);
+    printf("a: %s (%u bytes)\nb: %s (%u bytes)\n", a.title, a.count, b.title, b.count);
+
+    // Bytes are compared in order up to the first different one: after
+    // that, everything is out of step and only the position is useful.
+    unsigned late = 0, reported = 0, i;
+    double worst = 0;
+    const unsigned common = a.count < b.count ? a.count : b.count;
+    for (i = 0; i < common && a.bytes[i].c == b.bytes[i].c; i++) {
+        const double skew = b.bytes[i].ms - a.bytes[i].ms;
+        if (fabs(skew) > fabs(worst))
+            worst = skew;
+        if (fabs(skew) <= tolerance_ms)
+            continue;
+        late++;
+        if (reported++ < MAX_REPORTED)
+            printf("byte %u: %02X at %.3f ms in a, %.3f ms in b (%+.3f ms)\n", i, a.bytes[i].c, a.bytes[i].ms,
+                   b.bytes[i].ms, skew);
+    }
+
+    const bool same_bytes = i == a.count && i == b.count;
+    if (!same_bytes) {
+        printf("byte %u: ", i);
+        if (i < a.count)
+            printf("%02X at %.3f ms in a", a.bytes[i].c, a.bytes[i].ms);
+        else
+            printf("end of a");
+        if (i < b.count)
+            printf(", %02X at %.3f ms in b\n", b.bytes[i].c, b.bytes[i].ms);
+        else
+            printf(", end of b\n");
+        // Show what follows on both sides.
+        for (unsigned j = i; j < i + 8 && (j < a.count || j < b.count); j++) {
+            printf("  %4u:", j);
+            if (j < a.count)
+                printf(" %9.3f %02X", a.bytes[j].ms, a.bytes[j].c);
+            else
+                printf(" %12s", "");
+            if (j < b.count)
+                printf("   %9.3f %02X", b.bytes[j].ms, b.bytes[j].c);
+            printf("\n");
+        }
+    }
+
+    printf("%s: %u bytes match, %u outside %.1f ms, worst %+.3f ms\n", same_bytes && late == 0 ? "same" : "DIFFERENT",
+           i, late, tolerance_ms, worst);
+    free(a.bytes);
+    free(b.bytes);
+    return same_bytes && late == 0 ? 0 : 1;
+}
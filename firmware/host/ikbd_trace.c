@@ -0,0 +1,90 @@
+// ikbd_trace.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// Decodes the event trace drained with IKBD command 0xB4 from a capture of
+// the IKBD's output: raw bytes, or with -x hex bytes as text (see
+// ring_reader.h).
+//
+// Usage: ikbd_trace [-x] [capture]
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ring_reader.h"
+#include "trace.h"
+
+typedef struct {
+    const char *name;
+    const char *payload;
+    const char *format;
+} trace_id_t;
+
+static const trace_id_t trace_ids[] = {
+#define TRACE_ID(name, payload, format) { #name, payload, format },
+#include "trace_ids.h"
+#undef TRACE_ID
+};
+#define NUM_IDS (sizeof(trace_ids) / sizeof(trace_ids[0]))
+
+static void print_event(const uint8_t *e)
+{
+    const unsigned ms = e[0] << 8 | e[1];
+    const uint8_t *arg = e + 3;
+    if (e[2] >= NUM_IDS) {
+        printf("%5u  id 0x%02x  %02x %02x %02x %02x %02x\n", ms, e[2], arg[0], arg[1], arg[2], arg[3], arg[4]);
+        return;
+    }
+    const trace_id_t *id = &trace_ids[e[2]];
+    int v[5] = { 0 };
+    unsigned n = 0, pos = 0;
+    for (const char *p = id->payload; *p && pos < 5; p++) {
+        switch (*p) {
+        case 'w':
+            v[n++] = (int16_t)(arg[pos] << 8 | arg[pos + 1]);
+            pos += 2;
+            break;
+        case 'W':
+            v[n++] = arg[pos] << 8 | arg[pos + 1];
+            pos += 2;
+            break;
+        default:
+            v[n++] = arg[pos++];
+            break;
+        }
+    }
+    printf("%5u  %-22s ", ms, id->name);
+    printf(id->format, v[0], v[1], v[2], v[3], v[4]);
+    printf("\n");
+}
+
+static void print_block(const uint8_t *entries, const unsigned count, const unsigned lost, void *param)
+{
+    (void)param;
+    if (lost)
+        printf("# %u events lost\n", lost);
+    for (unsigned i = 0; i < count; i++)
+        print_event(entries + i * TRACE_ENTRY_SIZE);
+}
+
+int main(int argc, char **argv)
+{
+    bool hex = false;
+    int arg = 1;
+    if (arg < argc && strcmp(argv[arg], "-x") == 0) {
+        hex = true;
+        arg++;
+    }
+    if (argc - arg > 1) {
+        fprintf(stderr, "usage: %s [-x] [capture]\n", argv[0]);
+        return 2;
+    }
+    ring_capture_t cap;
+    ring_capture_load(&cap, arg < argc ? argv[arg] : NULL, hex);
+    const unsigned blocks =
+        ring_capture_read(&cap, 0x34, TRACE_ENTRY_SIZE, TRACE_RING_SIZE, print_block, NULL);
+    ring_capture_free(&cap);
+    return blocks ? 0 : 1;
+}
@@ -0,0 +1,22 @@
+// ps2_fake.cpp
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// Host version of the keyboard driver calls made by input.cpp: a set 2
+// keyboard that ignores commands.
+
+#include "ps2_keyboard.h"
+
+void PS2Keyboard::set_typematic(uint8_t rate_delay)
+{
+    (void)rate_delay;
+}
+
+void PS2Keyboard::select_scan_code_set_3()
+{
+}
+
+uint8_t PS2Keyboard::scan_code_set()
+{
+    return 2;
+}
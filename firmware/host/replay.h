@@ -0,0 +1,56 @@
+// replay.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// An IKBD engine driven by ikbd_replay. There are two: ours (ikbd.c on the
+// HAL fakes) and a reference built from Hatari's ikbd.c, so that the same
+// script can be played through both and the outputs compared.
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Name printed in the output header.
+extern const char *const engine_name;
+
+// Power up: cold reset, time 0.
+void engine_init(void);
+
+// Reset the MCU alone, as the watchdog or reset button would, with a
+// HAL_RESET_xxx cause; RAM marked HAL_NOINIT and EEPROM survive. Return
+// false if the engine has no MCU.
+bool engine_restart(uint8_t cause);
+
+// Move time forward, running the engine's timers and automatic reports.
+void engine_advance_us(uint32_t us);
+
+// A byte from the Atari to the IKBD.
+void engine_host_byte(uint8_t c);
+
+void engine_key(uint8_t st_scan_code, bool press);
+
+// Relative mouse motion and the button state.
+void engine_mouse(int dx, int dy, bool left, bool right);
+
+// Joystick state in ST format: bits 3:0 directions, bit 7 fire.
+void engine_joystick(int port, uint8_t st_bits);
+
+// Bytes as read from the PS/2 keyboard and mouse, before any decoding.
+// Return false if the engine has no PS/2 side.
+bool engine_ps2_keyboard(uint8_t c);
+bool engine_ps2_mouse(uint8_t c);
+
+// Next byte from the IKBD to the Atari, or -1.
+int engine_pop_output(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // REPLAY_H
@@ -0,0 +1,169 @@
+// replay_main.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// ikbd_replay: plays a script through an IKBD engine (see replay.h) and
+// prints every byte sent to the Atari with the time its stop bit ends, for
+// ikbd_diff. Both directions of the serial line run at 7812.5 baud, one
+// byte every 1280 us, whatever the engine.
+//
+// Usage: ikbd_replay script
+//
+// Each script line is "<time in ms> <command> [arguments]", in time order:
+//   host <hex bytes>            bytes from the Atari
+//   key <hex ST code> [up]      key press, or release with 'up'
+//   mouse <dx> <dy> [buttons]   relative motion, buttons 1 = left, 2 = right
+//   joy <port> <hex ST bits>    joystick state, bits 3:0 directions, 7 fire
+//   ps2key <hex bytes>          bytes from the PS/2 keyboard (scan code set 2)
+//   ps2mouse <hex bytes>        bytes from the PS/2 mouse
+//   restart <hex cause>         MCU reset with a HAL_RESET_xxx cause (hal.h)
+//   end                         stop here (default: 200 ms after the last line)
+// '#' starts a comment.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "replay.h"
+
+#define STEP_US 100
+#define BYTE_US 1280
+#define HOST_QUEUE_SIZE 256
+
+static uint8_t g_host_queue[HOST_QUEUE_SIZE];
+static unsigned g_host_head, g_host_tail;
+
+// Apply the rest of a script line, already split from its time with
+// strtok. Return true at 'end'.
+static bool run_line(const char *path, const int n)
+{
+    const char *cmd = strtok(NULL, " \t\r\n");
+    char *tok;
+    if (!cmd) {
+        fprintf(stderr, "%s:%d: missing command\n", path, n);
+        exit(2);
+    }
+    if (strcmp(cmd, "host") == 0) {
+        while ((tok = strtok(NULL, " \t\r\n")) != NULL) {
+            g_host_queue[g_host_tail] = (uint8_t)strtoul(tok, NULL, 16);
+            g_host_tail = (g_host_tail + 1) % HOST_QUEUE_SIZE;
+        }
+    } else if (strcmp(cmd, "key") == 0) {
+        tok = strtok(NULL, " \t\r\n");
+        const char *up = strtok(NULL, " \t\r\n");
+        if (!tok) {
+            fprintf(stderr, "%s:%d: missing scan code\n", path, n);
+            exit(2);
+        }
+        engine_key((uint8_t)strtoul(tok, NULL, 16), !(up && strcmp(up, "up") == 0));
+    } else if (strcmp(cmd, "mouse") == 0) {
+        int args[3] = { 0, 0, 0 };
+        for (int i = 0; i < 3 && (tok = strtok(NULL, " \t\r\n")) != NULL; i++)
+            args[i] = (int)strtol(tok, NULL, 0);
+        engine_mouse(args[0], args[1], args[2] & 1, args[2] & 2);
+    } else if (strcmp(cmd, "joy") == 0) {
+        const char *port = strtok(NULL, " \t\r\n");
+        const char *bits = strtok(NULL, " \t\r\n");
+        if (!port || !bits) {
+            fprintf(stderr, "%s:%d: joy needs a port and a value\n", path, n);
+            exit(2);
+        }
+        engine_joystick((int)strtol(port, NULL, 0), (uint8_t)strtoul(bits, NULL, 16));
+    } else if (strcmp(cmd, "ps2key") == 0 || strcmp(cmd, "ps2mouse") == 0) {
+        const bool mouse = cmd[3] == 'm';
+        while ((tok = strtok(NULL, " \t\r\n")) != NULL) {
+            const uint8_t c = (uint8_t)strtoul(tok, NULL, 16);
+            if (!(mouse ? engine_ps2_mouse(c) : engine_ps2_keyboard(c))) {
+                fprintf(stderr, "%s:%d: %s has no PS/2 input\n", path, n, engine_name);
+                exit(2);
+            }
+        }
+    } else if (strcmp(cmd, "restart") == 0) {
+        tok = strtok(NULL, " \t\r\n");
+        if (!tok) {
+            fprintf(stderr, "%s:%d: missing reset cause\n", path, n);
+            exit(2);
+        }
+        if (!engine_restart((uint8_t)strtoul(tok, NULL, 16))) {
+            fprintf(stderr, "%s:%d: %s has no MCU to restart\n", path, n, engine_name);
+            exit(2);
+        }
+    } else if (strcmp(cmd, "end") == 0) {
+        return true;
+    } else {
+        fprintf(stderr, "%s:%d: unknown command '%s'\n", path, n, cmd);
+        exit(2);
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s script\n", argv[0]);
+        return 2;
+    }
+    FILE *f = fopen(argv[1], "r");
+    if (!f) {
+        perror(argv[1]);
+        return 2;
+    }
+
+    engine_init();
+    printf("# %s %s\n", engine_name, argv[1]);
+
+    uint64_t now_us = 0, end_us = 0, host_free_us = 0, line_free_us = 0;
+    bool ended = false;
+    char line[256];
+    int n = 0;
+    bool have_line = false;
+    uint64_t line_us = 0;
+
+    for (;;) {
+        // Read up to the next timed line.
+        while (!have_line && !ended && fgets(line, sizeof(line), f)) {
+            n++;
+            char *hash = strchr(line, '#');
+            if (hash)
+                *hash = '\0';
+            const char *t = strtok(line, " \t\r\n");
+            if (!t)
+                continue;
+            line_us = (uint64_t)(strtod(t, NULL) * 1000);
+            have_line = true;
+        }
+        if (!have_line && !ended) {
+            ended = true;
+            end_us = now_us + 200000;
+        }
+        if (have_line && line_us <= now_us) {
+            have_line = false;
+            if (run_line(argv[1], n)) {
+                ended = true;
+                end_us = now_us;
+            }
+            continue;
+        }
+        if (ended && now_us >= end_us && g_host_head == g_host_tail)
+            break;
+
+        // Serial line, both ways.
+        if (g_host_head != g_host_tail && now_us >= host_free_us) {
+            engine_host_byte(g_host_queue[g_host_head]);
+            g_host_head = (g_host_head + 1) % HOST_QUEUE_SIZE;
+            host_free_us = now_us + BYTE_US;
+        }
+        if (now_us >= line_free_us) {
+            const int c = engine_pop_output();
+            if (c >= 0) {
+                line_free_us = now_us + BYTE_US;
+                printf("%.3f %02X\n", line_free_us / 1000.0, c);
+            }
+        }
+
+        engine_advance_us(STEP_US);
+        now_us += STEP_US;
+    }
+    fclose(f);
+    return 0;
+}
@@ -0,0 +1,95 @@
+// ring_reader.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#include "ring_reader.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void add_byte(ring_capture_t *cap, const uint8_t c)
+{
+    if (cap->count == cap->capacity) {
+        cap->capacity = cap->capacity ? cap->capacity * 2 : 4096;
+        cap->bytes = realloc(cap->bytes, cap->capacity);
+        if (!cap->bytes)
+            abort();
+    }
+    cap->bytes[cap->count++] = c;
+}
+
+void ring_capture_load(ring_capture_t *cap, const char *path, const bool hex)
+{
+    *cap = (ring_capture_t){ 0 };
+    FILE *f = stdin;
+    if (path && !(f = fopen(path, hex ? "r" : "rb"))) {
+        perror(path);
+        exit(2);
+    }
+    if (hex) {
+        char line[1024];
+        while (fgets(line, sizeof(line), f)) {
+            if (line[0] == '#')
+                continue;
+            for (char *tok = strtok(line, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n"))
+                if (strlen(tok) == 2 && isxdigit((unsigned char)tok[0]) && isxdigit((unsigned char)tok[1]))
+                    add_byte(cap, (uint8_t)strtoul(tok, NULL, 16));
+        }
+    } else {
+        int c;
+        while ((c = getc(f)) != EOF)
+            add_byte(cap, (uint8_t)c);
+    }
+    if (f != stdin)
+        fclose(f);
+}
+
+void ring_capture_free(ring_capture_t *cap)
+{
+    free(cap->bytes);
+    *cap = (ring_capture_t){ 0 };
+}
+
+unsigned ring_capture_read(const ring_capture_t *cap, const uint8_t command, const unsigned entry_size,
+                           const unsigned max_entries, const ring_block_fn fn, void *param)
+{
+    // Header, the entries, and room for the last packet's padding.
+    uint8_t *block = malloc(3 + max_entries * entry_size + 5);
+    unsigned size = 0, next = 0, blocks = 0;
+    bool in_block = false;
+    if (!block)
+        abort();
+    for (size_t i = 0; i + 8 <= cap->count; i++) {
+        const uint8_t *p = &cap->bytes[i];
+        if (p[0] != 0xf6 || p[1] != command)
+            continue;
+        if (p[2] == 0) {
+            if (in_block)
+                fprintf(stderr, "report %u is incomplete\n", blocks);
+            in_block = true;
+            size = next = 0;
+        } else if (!in_block || p[2] != next) {
+            fprintf(stderr, "unexpected packet %u\n", p[2]);
+            in_block = false;
+            continue;
+        }
+        memcpy(block + size, p + 3, 5);
+        size += 5;
+        next++;
+        i += 7;
+        if (block[0] > max_entries) {
+            fprintf(stderr, "report %u: bad entry count %u\n", blocks, block[0]);
+            in_block = false;
+        } else if (size >= 3 + block[0] * entry_size) {
+            fn(block + 3, block[0], block[1] << 8 | block[2], param);
+            blocks++;
+            in_block = false;
+        }
+    }
+    if (in_block)
+        fprintf(stderr, "report %u is incomplete\n", blocks);
+    free(block);
+    return blocks;
+}
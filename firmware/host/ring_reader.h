@@ -0,0 +1,36 @@
+// ring_reader.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// Reads the rings drained with the vendor IKBD commands 0xB4 (trace) and
+// 0xB5 (capture) out of a capture of the IKBD's output, for ikbd_trace and
+// ikbd_capture. See IKBD_Cmd_ReturnRing in ikbd.c for the packets.
+
+#ifndef RING_READER_H
+#define RING_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint8_t *bytes;
+    size_t count, capacity;
+} ring_capture_t;
+
+// Load a capture file (stdin if path is NULL): raw bytes, or with hex set
+// hex bytes as text (ikbd_replay output, a terminal log), where '#' lines
+// and anything that isn't a two digit hex byte are skipped. Exits on error.
+void ring_capture_load(ring_capture_t *cap, const char *path, bool hex);
+void ring_capture_free(ring_capture_t *cap);
+
+// Called for each ring report found, with its entries, oldest first.
+typedef void (*ring_block_fn)(const uint8_t *entries, unsigned count, unsigned lost, void *param);
+
+// Find the F6 <command> n packets in the capture, reassemble each report
+// and pass it on. Other IKBD packets are ignored. Return the number of
+// complete reports.
+unsigned ring_capture_read(const ring_capture_t *cap, uint8_t command, unsigned entry_size, unsigned max_entries,
+                           ring_block_fn fn, void *param);
+
+#endif // RING_READER_H
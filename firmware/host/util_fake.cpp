@@ -0,0 +1,39 @@
+// util_fake.cpp
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// Host version of util.cpp on top of the fake UART queues.
+
+#include "util.h"
+#include "hal_fake.h"
+
+unsigned char recv_byte(bool *avail)
+{
+    const int c = hal_fake_uart_pop_rx();
+    *avail = c >= 0;
+    return *avail ? (unsigned char)c : 0;
+}
+
+void send_byte(unsigned char c)
+{
+    hal_fake_uart_push_tx(c);
+}
+
+int send_room(void)
+{
+    // As much as the Arduino core buffers; the fake UART holds more.
+    return 63;
+}
+
+int send_pending(void)
+{
+    return 0;
+}
+
+void send_str(const char *str)
+{
+    while (*str) {
+        send_byte(*str);
+        str++;
+    }
+}
@@ -9,15 +9,22 @@
   SPDX-License-Identifier: GPL-2.0-or-later
 */
 #include <stdint.h>
+#include "capture.h"
+#include "config.h"
+#include "hal.h"
 #include "ikbd.h"
+#include "ikbd_packet.h"
 #include "joy.h"
-#include <Arduino.h>
+#include "perf.h"
+#include "profile.h"
+#include "remap.h"
+#include "settings.h"
+#include "snapshot.h"
+#include "trace.h"
+#include "watchdog.h"
+#include <stdlib.h>
 #include <string.h>
 
-#define TRACE_IKBD_CMDS 1
-#define TRACE_IKBD_ACIA 2
-#define TRACE_IKBD_ALL (TRACE_IKBD_CMDS | TRACE_IKBD_ACIA)
-
 #define ACIA_CYCLES    7200         /* Cycles (Multiple of 4) between sent to ACIA from keyboard along serial line - 500Hz/64, (approx' 6920-7200cycles from test program) */
 #define ABS_X_ONRESET    0          /* Initial XY for absolute mouse position after RESET command */
 #define ABS_Y_ONRESET    0
@@ -32,15 +39,17 @@
 #define CALL_VAR(func)  { ((void(*)(void))func)(); }
 
 static bool bMouseDisabled, bJoystickDisabled;
+static uint8_t MouseOptions;                            /* MOUSE_OPTION_xxx, see command 0x3C */
+static int AbsPushedX, AbsPushedY;                      /* last position sent with MOUSE_OPTION_ABS_PUSH */
+static uint8_t AbsButtonEdges;                          /* 0xF7 press/release bits not pushed yet */
+
+#define MOUSE_OPTION_HIRES      0x01                    /* relative motion in 0x7C packets */
+#define MOUSE_OPTION_ABS_PUSH   0x02                    /* absolute position sent when it changes */
+#define MOUSE_OPTIONS           0x03
 static bool bDuringResetCriticalTime, bBothMouseAndJoy;
 static bool bMouseEnabledDuringReset;
 
 
-static void LOG_TRACE(int level, ...)
-{
-    // Nothing right now.
-}
-
 typedef struct {
     /* Date/Time is stored in the IKBD using 6 bytes in BCD format */
     /* Clock is cleared on cold reset, but keeps its values on warm reset */
@@ -53,6 +62,15 @@ typedef struct {
 static IKBD_STRUCT      IKBD;
 static IKBD_STRUCT      *pIKBD = &IKBD;
 
+KEYBOARD_PROCESSOR KeyboardProcessor;
+KEYBOARD Keyboard;
+
+PS2_MOUSE_CONFIG MouseConfig = {
+    PS2_MOUSE_SAMPLE_RATE, PS2_MOUSE_RESOLUTION, PS2_MOUSE_SCALING, PS2_MOUSE_REMOTE_MODE
+};
+KEYBOARD_LEDS KeyboardLeds;
+volatile PERF_COUNTERS PerfCounters;
+
 static void     IKBD_Boot_ROM ( bool ClearAllRAM );
 static bool     IKBD_OutputBuffer_CheckFreeCount ( int Nb );
 static int		IKBD_Delay_Random ( int min, int max );
@@ -61,7 +79,14 @@ static void     IKBD_Cmd_Return_Byte ( uint8_t Data );
 static void     IKBD_Cmd_Return_Byte_Delay ( uint8_t Data, int Delay_Cycles );
 static void		IKBD_Send_Byte_Delay ( uint8_t Data, int Delay_Cycles );
 
-static uint8_t  ScanCodeState[ 128 ];                   /* state of each key : 0=released 1=pressed */
+static uint8_t  KeysDown[ 16 ] HAL_NOINIT;              /* state of each key, a bit per scancode : 1=pressed */
+static uint8_t  KeysDownCheck HAL_NOINIT;               /* XOR of KeysDown[] and KEYS_DOWN_CHECK, to tell if they survived a reset */
+#define KEYS_DOWN_CHECK 0xA5
+static uint8_t  PendingBreaks[ 16 ];                    /* break codes waiting for room in the output buffer, a bit per key */
+static uint8_t  PendingMakes[ 16 ];                     /* make codes waiting behind them, a bit per key */
+static bool     bBreaksPending, bMakesPending;
+
+static void     IKBD_SendPendingKeys ( void );
 
 
 /* List of possible keyboard commands, others are seen as NOPs by keyboard processor */
@@ -73,6 +98,7 @@ static void IKBD_Cmd_MouseCursorKeycodes();
 static void IKBD_Cmd_SetMouseThreshold();
 static void IKBD_Cmd_SetMouseScale();
 static void IKBD_Cmd_ReadAbsMousePos();
+static void IKBD_SendAbsMousePacket ( int Delay_Cycles );
 static void IKBD_Cmd_SetInternalMousePos();
 static void IKBD_Cmd_SetYAxisDown();
 static void IKBD_Cmd_SetYAxisUp();
@@ -95,6 +121,38 @@ static void IKBD_Cmd_ReportMouseAvailability(void);
 static void IKBD_Cmd_ReportJoystickMode(void);
 static void IKBD_Cmd_ReportJoystickAvailability(void);
 
+/* KEMOJO extensions */
+static void IKBD_Cmd_SetPS2MouseParams(void);
+static void IKBD_Cmd_ReportPS2MouseParams(void);
+static void IKBD_Cmd_SetKeyboardLeds(void);
+static void IKBD_Cmd_ReportKeyboardLeds(void);
+static void IKBD_Cmd_ClearPerfCounters(void);
+static void IKBD_Cmd_ReportPerfCounters(void);
+#if PROFILE_BUILD
+static void IKBD_Cmd_ClearProfile(void);
+static void IKBD_Cmd_ReportProfile(void);
+#endif
+#if TRACE_ENA
+static void IKBD_Cmd_ClearTrace(void);
+static void IKBD_Cmd_ReportTrace(void);
+#endif
+#if CAPTURE_ENA
+static void IKBD_Cmd_SetCaptureMode(void);
+static void IKBD_Cmd_ReportCapture(void);
+#endif
+static void IKBD_Cmd_SetSetting(void);
+static void IKBD_Cmd_Settings(void);
+static void IKBD_Cmd_ReportSettings(void);
+static void IKBD_Cmd_SetKeyMap(void);
+static void IKBD_Cmd_ReportKeyMap(void);
+static void IKBD_Cmd_SetMacro(void);
+static void IKBD_Cmd_ReportMacro(void);
+static void IKBD_Cmd_ClearWatchdog(void);
+static void IKBD_Cmd_ReportWatchdog(void);
+static void IKBD_Cmd_ReportKeyState(void);
+static void IKBD_Cmd_SetMouseOptions(void);
+static void IKBD_Cmd_ReportMouseOptions(void);
+
 /* Keyboard Command */
 static const struct {
     uint8_t Command;
@@ -139,6 +197,38 @@ static const struct {
     {0x99, 1, IKBD_Cmd_ReportJoystickMode},
     {0x9A, 1, IKBD_Cmd_ReportJoystickAvailability},
 
+    /* KEMOJO extensions, ignored by a real IKBD */
+    {0x30, 5, IKBD_Cmd_SetPS2MouseParams},
+    {0xB0, 1, IKBD_Cmd_ReportPS2MouseParams},
+    {0x31, 3, IKBD_Cmd_SetKeyboardLeds},
+    {0xB1, 1, IKBD_Cmd_ReportKeyboardLeds},
+    {0x32, 1, IKBD_Cmd_ClearPerfCounters},
+    {0xB2, 1, IKBD_Cmd_ReportPerfCounters},
+#if PROFILE_BUILD
+    {0x33, 1, IKBD_Cmd_ClearProfile},
+    {0xB3, 2, IKBD_Cmd_ReportProfile},
+#endif
+#if TRACE_ENA
+    {0x34, 1, IKBD_Cmd_ClearTrace},
+    {0xB4, 1, IKBD_Cmd_ReportTrace},
+#endif
+#if CAPTURE_ENA
+    {0x35, 2, IKBD_Cmd_SetCaptureMode},
+    {0xB5, 1, IKBD_Cmd_ReportCapture},
+#endif
+    {0x36, 5, IKBD_Cmd_SetSetting},
+    {0x37, 2, IKBD_Cmd_Settings},
+    {0xB6, 1, IKBD_Cmd_ReportSettings},
+    {0x38, 3, IKBD_Cmd_SetKeyMap},
+    {0xB8, 2, IKBD_Cmd_ReportKeyMap},
+    {0x39, 7, IKBD_Cmd_SetMacro},
+    {0xB9, 2, IKBD_Cmd_ReportMacro},
+    {0x3A, 1, IKBD_Cmd_ClearWatchdog},
+    {0xBA, 1, IKBD_Cmd_ReportWatchdog},
+    {0xBB, 1, IKBD_Cmd_ReportKeyState},
+    {0x3C, 2, IKBD_Cmd_SetMouseOptions},
+    {0xBC, 1, IKBD_Cmd_ReportMouseOptions},
+
     {0xFF, 0, NULL} /* Term */
 
 };
@@ -151,7 +241,7 @@ static const struct {
  */
 void	IKBD_Init ( void )
 {
-    LOG_TRACE ( TRACE_IKBD_ALL, "ikbd init\n" );
+    TRACE ( INIT );
 }
 
 /* This function is called after a hardware reset of the IKBD.
@@ -171,33 +261,6 @@ void    IKBD_Reset ( bool bCold )
         IKBD_Boot_ROM ( false );
 }
 
-static void SetupTimer1OneShot()
-{
-    // Configure Timer1 to interrupt in 1/16 of a second.
-    noInterrupts();           // Disable interrupts during setup
-
-    // Clear Timer1 control registers
-    TCCR1A = 0;
-    TCCR1B = 0;
-    TCNT1 = 0;               // Initialize counter
-
-    // Set compare match register for 1Hz increments
-    // 16MHz Arduino clock / 256 prescaler / 16Hz = 3906
-    // 7372800 Hz Arduino clock / 256 prescaral / 16 Hz =
-    /* OCR1A = 3906; *//* Perhaps should calc based on IKBD_RESET_CYCLES */
-    OCR1A = 1800;
-    // Turn on CTC mode (Clear Timer on Compare Match)
-    TCCR1B |= (1 << WGM12);
-
-    // Set prescaler to 256
-    TCCR1B |= (1 << CS12);
-
-    // Enable timer compare interrupt
-    TIMSK1 |= (1 << OCIE1A);
-
-    interrupts();            // Enable interrupts
-}
-
 volatile bool ledState = false;
 
 /* This function emulates the boot code stored in the ROM at address $F000.
@@ -211,7 +274,7 @@ static void     IKBD_Boot_ROM ( bool ClearAllRAM )
     int     i;
 
 
-    LOG_TRACE ( TRACE_IKBD_ALL, "ikbd boot rom clear_all=%s\n", ClearAllRAM?"yes":"no" );
+    TRACE1 ( BOOT_ROM, ClearAllRAM );
 
     /* Clear clock data when the 128 bytes of RAM are cleared */
     if ( ClearAllRAM ) {
@@ -240,8 +303,11 @@ static void     IKBD_Boot_ROM ( bool ClearAllRAM )
 
     KeyboardProcessor.Joy.PrevJoyData[0] = KeyboardProcessor.Joy.PrevJoyData[1] = 0;
 
-    for ( i=0 ; i<128 ; i++ )
-        ScanCodeState[ i ] = 0;                         /* key is released */
+    memset ( KeysDown, 0, sizeof(KeysDown) );           /* keys are released */
+    KeysDownCheck = KEYS_DOWN_CHECK;
+    memset ( PendingBreaks, 0, sizeof(PendingBreaks) );
+    memset ( PendingMakes, 0, sizeof(PendingMakes) );
+    bBreaksPending = bMakesPending = false;
 
     /* Reset our keyboard states and clear key state table */
     Keyboard.BufferHead = Keyboard.BufferTail = 0;
@@ -258,6 +324,9 @@ static void     IKBD_Boot_ROM ( bool ClearAllRAM )
 
     /* Store bool for when disable mouse or joystick */
     bMouseDisabled = bJoystickDisabled = false;
+    MouseOptions = 0;
+    AbsPushedX = AbsPushedY = -1;
+    AbsButtonEdges = 0;
     /* do emulate hardware 'quirk' where if disable both with 'x' time
      * of a RESET command they are ignored! */
     bDuringResetCriticalTime = true;
@@ -267,7 +336,7 @@ static void     IKBD_Boot_ROM ( bool ClearAllRAM )
 #if 0
     /* Remove any custom handlers used to emulate code loaded to the 6301's RAM */
     if ( ( MemoryLoadNbBytesLeft != 0 ) || ( IKBD_ExeMode == true ) ) {
-        LOG_TRACE ( TRACE_IKBD_ALL, "ikbd stop memory load and turn off custom exe\n" );
+        TRACE ( STOP_MEMORY_LOAD );
 
         MemoryLoadNbBytesLeft = 0;
         pIKBD_CustomCodeHandler_Read = NULL;
@@ -280,10 +349,10 @@ static void     IKBD_Boot_ROM ( bool ClearAllRAM )
     /* is stuck. We use a timer to emulate the time needed for this part */
     /* (eg Lotus Turbo Esprit 2 requires at least a delay of 50000 cycles */
     /* or it will crash during start up) */
-    /* For debug, turn on the debug LED (set its pin low) during the reset period. */
-    ledState = false;
-    digitalWrite(PIN7, ledState);
-    SetupTimer1OneShot();
+    /* For debug, turn on the debug LED during the reset period. */
+    ledState = true;
+    hal_led(ledState);
+    hal_reset_timer_start();
 
 #if 0
     /* Add auto-update function to the queue */
@@ -293,29 +362,148 @@ static void     IKBD_Boot_ROM ( bool ClearAllRAM )
     if ( CycInt_InterruptActive ( INTERRUPT_IKBD_AUTOSEND ) == false )
         CycInt_AddRelativeInterrupt ( Keyboard.AutoSendCycles, INT_CPU8_CYCLE, INTERRUPT_IKBD_AUTOSEND );
 #endif
-    LOG_TRACE ( TRACE_IKBD_ALL, "ikbd reset done, starting reset timer\n" );
+    TRACE ( RESET_DONE );
 }
 
-ISR(TIMER1_COMPA_vect)
+/*-----------------------------------------------------------------------*/
+/**
+ * Called by the HAL when the one-shot reset timer expires.
+ */
+void IKBD_InterruptHandler_ResetTimer(void)
 {
-    /* We are using the timer as a one shot, so turn off its interrupt. */
-    //TIMSK1 &= ~(1 << OCIE1A); // Disable timer compare interrupt
-
     /* Reset timer is over */
     bDuringResetCriticalTime = false;
     bMouseEnabledDuringReset = false;
 
-    /* Return $F1 when IKBD's boot is complete */
-    IKBD_Cmd_Return_Byte_Delay ( IKBD_ROM_VERSION, IKBD_Delay_Random ( 0, 3000 ) );
+    /* Return $F1 when IKBD's boot is complete. This runs in the timer
+     * interrupt, where random() and its 32 bit division would eat into the
+     * PS/2 clock budget, and the delay is not used anyway. */
+    IKBD_Cmd_Return_Byte ( IKBD_ROM_VERSION );
 
     /*
      * Toggle the LED state, which should turn it off. If this interrupt handler is called multiple times,
      * the LED will blink.
      */
     ledState = !ledState;
-    digitalWrite(PIN7, ledState);
-    TIMSK1 &= ~(1 << OCIE1A);
-    //digitalWrite(PIN7, true); // Pin high turns off the LED.
+    hal_led(ledState);
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Save the state set up by the host to a snapshot that survives a reset of
+ * the MCU alone (see snapshot.h), or restore it after such a reset.
+ * Restoring skips the IKBD boot: the host sees no 0xF1 and its mouse,
+ * joystick and clock settings stay as they were. Without a snapshot to
+ * restore, this is a cold IKBD_Reset().
+ * The mouse position and clock come last : they change all the time, so
+ * they are left out of the EEPROM copy (SNAPSHOT_STORED bytes).
+ */
+#define SNAPSHOT_SIZE 32
+#define SNAPSHOT_STORED 21
+
+void IKBD_MemorySnapShot_Capture(bool bSave)
+{
+    uint8_t Snap[SNAPSHOT_SIZE];
+    uint8_t Down[16], Check;
+    uint8_t *p = Snap;
+    int i;
+
+    if ( bSave ) {
+        *p++ = KeyboardProcessor.MouseMode;
+        *p++ = KeyboardProcessor.JoystickMode;
+        *p++ = KeyboardProcessor.Abs.MaxX >> 8;
+        *p++ = KeyboardProcessor.Abs.MaxX;
+        *p++ = KeyboardProcessor.Abs.MaxY >> 8;
+        *p++ = KeyboardProcessor.Abs.MaxY;
+        *p++ = KeyboardProcessor.Mouse.XScale;
+        *p++ = KeyboardProcessor.Mouse.YScale;
+        *p++ = KeyboardProcessor.Mouse.XThreshold;
+        *p++ = KeyboardProcessor.Mouse.YThreshold;
+        *p++ = KeyboardProcessor.Mouse.KeyCodeDeltaX;
+        *p++ = KeyboardProcessor.Mouse.KeyCodeDeltaY;
+        *p++ = KeyboardProcessor.Mouse.YAxis;
+        *p++ = KeyboardProcessor.Mouse.Action;
+        *p++ = bMouseDisabled | bJoystickDisabled << 1 | Keyboard.PauseOutput << 2 | bBothMouseAndJoy << 3
+               | MouseOptions << 4;
+        *p++ = MouseConfig.SampleRate;
+        *p++ = MouseConfig.Resolution;
+        *p++ = MouseConfig.Scaling;
+        *p++ = MouseConfig.RemoteMode;
+        *p++ = KeyboardLeds.Leds;
+        *p++ = KeyboardLeds.HostControl;
+        *p++ = KeyboardProcessor.Abs.X >> 8;
+        *p++ = KeyboardProcessor.Abs.X;
+        *p++ = KeyboardProcessor.Abs.Y >> 8;
+        *p++ = KeyboardProcessor.Abs.Y;
+        *p++ = KeyboardProcessor.Abs.PrevReadAbsMouseButtons;
+        for ( i = 0 ; i < 6 ; i++ )
+            *p++ = pIKBD->Clock[ i ];
+        snapshot_save ( Snap, SNAPSHOT_SIZE, SNAPSHOT_STORED );
+        return;
+    }
+
+    if ( !snapshot_restore ( Snap, SNAPSHOT_SIZE ) ) {
+        IKBD_Reset ( true );
+        return;
+    }
+
+    /* The releases of the keys held across the reset went with it: send */
+    /* them once the IKBD runs again. KeysDown[] only counts if it */
+    /* survived the reset, i.e. still matches KeysDownCheck. */
+    Check = KEYS_DOWN_CHECK;
+    for ( i = 0 ; i < 16 ; i++ ) {
+        Down[ i ] = KeysDown[ i ];
+        Check ^= KeysDown[ i ];
+    }
+    if ( Check != KeysDownCheck )
+        memset ( Down, 0, sizeof(Down) );
+
+    /* Clear the buffers as a reset would, but without the boot delay */
+    IKBD_Boot_ROM ( false );
+    for ( i = 0 ; i < 16 ; i++ ) {
+        PendingBreaks[ i ] = Down[ i ];
+        if ( Down[ i ] )
+            bBreaksPending = true;
+    }
+    hal_reset_timer_stop();
+    bDuringResetCriticalTime = false;
+    ledState = false;
+    hal_led(ledState);
+
+    KeyboardProcessor.MouseMode = *p++;
+    KeyboardProcessor.JoystickMode = *p++;
+    KeyboardProcessor.Abs.MaxX = (int16_t)( p[0] << 8 | p[1] );
+    KeyboardProcessor.Abs.MaxY = (int16_t)( p[2] << 8 | p[3] );
+    p += 4;
+    KeyboardProcessor.Mouse.XScale = *p++;
+    KeyboardProcessor.Mouse.YScale = *p++;
+    KeyboardProcessor.Mouse.XThreshold = *p++;
+    KeyboardProcessor.Mouse.YThreshold = *p++;
+    KeyboardProcessor.Mouse.KeyCodeDeltaX = *p++;
+    KeyboardProcessor.Mouse.KeyCodeDeltaY = *p++;
+    KeyboardProcessor.Mouse.YAxis = (int8_t)*p++;
+    KeyboardProcessor.Mouse.Action = *p++;
+    bMouseDisabled = *p & 1;
+    bJoystickDisabled = ( *p & 2 ) != 0;
+    Keyboard.PauseOutput = ( *p & 4 ) != 0;
+    bBothMouseAndJoy = ( *p & 8 ) != 0;
+    MouseOptions = *p++ >> 4;
+    MouseConfig.SampleRate = *p++;
+    MouseConfig.Resolution = *p++;
+    MouseConfig.Scaling = *p++;
+    MouseConfig.RemoteMode = *p++;
+    KeyboardLeds.Leds = *p++;
+    KeyboardLeds.HostControl = *p++;
+    KeyboardProcessor.Abs.X = (int16_t)( p[0] << 8 | p[1] );
+    KeyboardProcessor.Abs.Y = (int16_t)( p[2] << 8 | p[3] );
+    p += 4;
+    KeyboardProcessor.Abs.PrevReadAbsMouseButtons = *p++;
+    for ( i = 0 ; i < 6 ; i++ )
+        pIKBD->Clock[ i ] = *p++;
+
+    Mouse_ApplyConfig();
+    Keyboard_ApplyLeds();
+    TRACE2 ( SNAPSHOT_RESTORED, KeyboardProcessor.MouseMode, KeyboardProcessor.JoystickMode );
 }
 
 /*-----------------------------------------------------------------------*/
@@ -337,19 +525,41 @@ static bool     IKBD_OutputBuffer_CheckFreeCount ( int Nb )
         return true;
 
     else {
-        LOG_TRACE ( TRACE_IKBD_ACIA, "ikbd acia output buffer is full, can't send %d bytes\n",
-                    Nb);
+        TRACE1 ( OUTPUT_FULL, Nb );
+        PerfCounters.packets_dropped++;
         return false;
     }
 }
 
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Return the number of bytes of the packet at the head of the output
+ * buffer, so that it can be sent in one go. Packets are stored whole,
+ * and their length follows from their header byte (ikbd_packet.h).
+ */
+int	IKBD_OutputPacketLength ( void )
+{
+    int Nb;
+
+    if ( Keyboard.NbBytesInOutputBuffer == 0 )
+        return 0;
+
+    if ( KeyboardProcessor.JoystickMode == AUTOMODE_JOYSTICK_MONITORING )
+        Nb = 2;
+    else
+        Nb = ikbd_packet_length ( Keyboard.Buffer[ Keyboard.BufferHead ] );
+
+    return Nb < Keyboard.NbBytesInOutputBuffer ? Nb : Keyboard.NbBytesInOutputBuffer;
+}
+
+
 
 /* From lib/arduino/core/WMath.cpp */
 long arduino_random(const long howsmall, const long howbig)
 {
     if (howsmall >= howbig) return howsmall;
-    return random() % howbig + howsmall;
+    return hal_random() % howbig + howsmall;
 }
 
 /*-----------------------------------------------------------------------*/
@@ -399,7 +609,7 @@ static void	IKBD_Send_Byte_Delay ( const uint8_t Data, int Delay_Cycles )
     //fprintf ( stderr , "send byte=0x%02x delay=%d\n" , Data , Delay_Cycles );
     /* Is keyboard initialised yet ? Ignore any bytes until it is */
     if ( bDuringResetCriticalTime ) {
-        LOG_TRACE ( TRACE_IKBD_ACIA, "ikbd is resetting, can't send byte=0x%02x\n", Data);
+        TRACE1 ( SEND_DURING_RESET, Data );
         return;
     }
 
@@ -409,7 +619,9 @@ static void	IKBD_Send_Byte_Delay ( const uint8_t Data, int Delay_Cycles )
         Keyboard.Buffer[Keyboard.BufferTail++] = Data;
         Keyboard.BufferTail &= KEYBOARD_BUFFER_MASK;
         Keyboard.NbBytesInOutputBuffer++;
-    } else LOG_TRACE(TRACE_IKBD_ACIA, "IKBD buffer is full, can't send 0x%02x!\n", Data );
+        if ( Keyboard.NbBytesInOutputBuffer > PerfCounters.output_high )
+            PerfCounters.output_high = Keyboard.NbBytesInOutputBuffer;
+    } else TRACE1 ( OUTPUT_FULL, 1 );
 }
 
 /*-----------------------------------------------------------------------*/
@@ -500,6 +712,80 @@ static void IKBD_DuplicateMouseFireButtons(void)
     }
 }
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Send the relative mouse motion as one high resolution packet (KEMOJO
+ * extension, see command 0x3C): 0x7C | buttons, then X and Y as signed 16
+ * bits, big endian. One packet carries any motion, where fast moves take
+ * several 0xF8 packets. 0x7C-0x7F are never sent as key codes.
+ */
+static void IKBD_SendHiResMousePacket(void)
+{
+    int RelX = KeyboardProcessor.Mouse.DeltaX;
+    int RelY = KeyboardProcessor.Mouse.DeltaY;
+    uint8_t Header;
+
+    if ( RelX > 32767 )		RelX = 32767;
+    if ( RelX < -32768 )		RelX = -32768;
+    if ( RelY > 32767 )		RelY = 32767;
+    if ( RelY < -32768 )		RelY = -32768;
+
+    if ( ( ( RelX < 0 ) && ( RelX <= -KeyboardProcessor.Mouse.XThreshold ) )
+            || ( ( RelX > 0 ) && ( RelX >= KeyboardProcessor.Mouse.XThreshold ) )
+            || ( ( RelY < 0 ) && ( RelY <= -KeyboardProcessor.Mouse.YThreshold ) )
+            || ( ( RelY > 0 ) && ( RelY >= KeyboardProcessor.Mouse.YThreshold ) )
+            || ( !IKBD_ButtonsEqual(Keyboard.bOldLButtonDown,Keyboard.bLButtonDown ) )
+            || ( !IKBD_ButtonsEqual(Keyboard.bOldRButtonDown,Keyboard.bRButtonDown ) ) ) {
+        Header = 0x7c;
+        if (Keyboard.bLButtonDown)
+            Header |= 0x02;
+        if (Keyboard.bRButtonDown)
+            Header |= 0x01;
+
+        if ( IKBD_OutputBuffer_CheckFreeCount ( 5 ) ) {
+            IKBD_Cmd_Return_Byte (Header);
+            IKBD_Cmd_Return_Byte (RelX >> 8);
+            IKBD_Cmd_Return_Byte (RelX);
+            IKBD_Cmd_Return_Byte ((RelY*KeyboardProcessor.Mouse.YAxis) >> 8);
+            IKBD_Cmd_Return_Byte (RelY*KeyboardProcessor.Mouse.YAxis);
+        }
+
+        KeyboardProcessor.Mouse.DeltaX -= RelX;
+        KeyboardProcessor.Mouse.DeltaY -= RelY;
+
+        /* Store buttons for next time around */
+        Keyboard.bOldLButtonDown = Keyboard.bLButtonDown;
+        Keyboard.bOldRButtonDown = Keyboard.bRButtonDown;
+    }
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Send the absolute mouse position as if the host had asked with command
+ * 0x0D, when it or the buttons changed since the last one (KEMOJO
+ * extension, see command 0x3C). Called once per report tick, so that the
+ * host doesn't have to poll; button edges between two ticks are latched
+ * by IKBD_SetMouseButtons().
+ */
+static void IKBD_SendAbsMousePush(void)
+{
+    const uint8_t Buttons = ( Keyboard.bRButtonDown ? 0x01 : 0x02 ) | ( Keyboard.bLButtonDown ? 0x04 : 0x08 );
+
+    if ( KeyboardProcessor.Abs.X == AbsPushedX && KeyboardProcessor.Abs.Y == AbsPushedY
+            && Buttons == KeyboardProcessor.Abs.PrevReadAbsMouseButtons && !AbsButtonEdges )
+        return;
+
+    /* Without room, try again on the next tick */
+    if ( !IKBD_OutputBuffer_CheckFreeCount ( 6 ) )
+        return;
+
+    AbsPushedX = KeyboardProcessor.Abs.X;
+    AbsPushedY = KeyboardProcessor.Abs.Y;
+    IKBD_SendAbsMousePacket ( 0 );
+}
+
+
 /*-----------------------------------------------------------------------*/
 /**
  * Send 'relative' mouse position
@@ -511,6 +797,11 @@ static void IKBD_SendRelMousePacket(void)
     int ByteRelX,ByteRelY;
     uint8_t Header;
 
+    if ( MouseOptions & MOUSE_OPTION_HIRES ) {
+        IKBD_SendHiResMousePacket();
+        return;
+    }
+
     while ( true ) {
         ByteRelX = KeyboardProcessor.Mouse.DeltaX;
         if ( ByteRelX > 127 )		ByteRelX = 127;
@@ -685,7 +976,7 @@ static void IKBD_SendOnMouseAction(void)
         if (bReportPosition) {
             /* Only report if mouse in absolute mode */
             if (KeyboardProcessor.MouseMode==AUTOMODE_MOUSEABS) {
-                LOG_TRACE(TRACE_IKBD_CMDS, "Report ABS on MouseAction\n");
+                TRACE(REPORT_ABS_ON_ACTION);
                 IKBD_Cmd_ReadAbsMousePos();
             }
         }
@@ -797,12 +1088,18 @@ void IKBD_SendAutoKeyboardCommands(void)
         return;
     }
 
+    /* Send the key events kept back while the output buffer was full */
+    IKBD_SendPendingKeys();
+
     /* Send automatic joystick packets */
     if (KeyboardProcessor.JoystickMode==AUTOMODE_JOYSTICK)
         IKBD_SendAutoJoysticks();
     /* Send automatic relative mouse positions(absolute are not send automatically) */
     if (KeyboardProcessor.MouseMode==AUTOMODE_MOUSEREL)
         IKBD_SendRelMousePacket();
+    /* unless asked to with MOUSE_OPTION_ABS_PUSH */
+    else if (KeyboardProcessor.MouseMode==AUTOMODE_MOUSEABS && (MouseOptions & MOUSE_OPTION_ABS_PUSH))
+        IKBD_SendAbsMousePush();
     /* Send cursor key directions for movements */
     else if (KeyboardProcessor.MouseMode==AUTOMODE_MOUSECURSOR)
         IKBD_SendCursorMousePacket();
@@ -826,34 +1123,182 @@ void IKBD_SendAutoKeyboardCommands(void)
 #endif
 }
 
+/*-----------------------------------------------------------------------*/
+/**
+ * State of an ST key in KeysDown[].
+ */
+static bool IKBD_KeyDown ( uint8_t ScanCode )
+{
+    return ( KeysDown[ ScanCode >> 3 ] >> ( ScanCode & 7 ) ) & 1;
+}
+
+static void IKBD_SetKeyDown ( uint8_t ScanCode, bool bDown )
+{
+    const uint8_t Mask = 1 << ( ScanCode & 7 );
+
+    if ( IKBD_KeyDown ( ScanCode ) != bDown ) {
+        KeysDown[ ScanCode >> 3 ] ^= Mask;
+        KeysDownCheck ^= Mask;
+    }
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Set the state of the mouse buttons. With MOUSE_OPTION_ABS_PUSH in
+ * absolute mode, presses and releases are latched as they happen, so that
+ * a click shorter than a report tick still shows in the next 0xF7 packet.
+ */
+void IKBD_SetMouseButtons(bool bLeft, bool bRight)
+{
+    const bool bOldLeft = Keyboard.bLButtonDown & BUTTON_MOUSE;
+    const bool bOldRight = Keyboard.bRButtonDown & BUTTON_MOUSE;
+
+    if ( KeyboardProcessor.MouseMode == AUTOMODE_MOUSEABS && ( MouseOptions & MOUSE_OPTION_ABS_PUSH ) ) {
+        if ( bRight != bOldRight )
+            AbsButtonEdges |= bRight ? 0x01 : 0x02;
+        if ( bLeft != bOldLeft )
+            AbsButtonEdges |= bLeft ? 0x04 : 0x08;
+    }
+
+    if ( bLeft )
+        Keyboard.bLButtonDown |= BUTTON_MOUSE;
+    else
+        Keyboard.bLButtonDown &= ~BUTTON_MOUSE;
+    if ( bRight )
+        Keyboard.bRButtonDown |= BUTTON_MOUSE;
+    else
+        Keyboard.bRButtonDown &= ~BUTTON_MOUSE;
+}
+
 /*-----------------------------------------------------------------------*/
 /**
  * When press/release key under host OS, execute this function.
+ * Return true for a press the host gets (now or once the output buffer
+ * has room), false for a repeat or a key not reported.
  */
-void IKBD_PressSTKey(uint8_t ScanCode, bool bPress)
+bool IKBD_PressSTKey(uint8_t ScanCode, bool bPress)
 {
     /* If IKBD is monitoring only joysticks, don't report key */
     if ( KeyboardProcessor.JoystickMode == AUTOMODE_JOYSTICK_MONITORING )
-        return;
-
-    /* Store the state of each ST scancode : 1=pressed 0=released */
-    if ( bPress )           ScanCodeState[ ScanCode & 0x7f ] = 1;
-    else                    ScanCodeState[ ScanCode & 0x7f ] = 0;
+        return false;
 
-    if (!bPress)
-        ScanCode |= 0x80;                               /* Set top bit if released key */
+    ScanCode &= 0x7f;
 
-    if ( IKBD_OutputBuffer_CheckFreeCount ( 1 ) ) {
-        IKBD_Cmd_Return_Byte (ScanCode);                /* Add to the IKBD's output buffer */
+    /* A release is never dropped: with the output buffer full, it waits in */
+    /* PendingBreaks[] for IKBD_SendPendingKeys() */
+    if ( !bPress ) {
+        IKBD_SetKeyDown ( ScanCode, false );
+        /* The host never saw a press still waiting, so drop both */
+        if ( PendingMakes[ ScanCode >> 3 ] & ( 1 << ( ScanCode & 7 ) ) ) {
+            PendingMakes[ ScanCode >> 3 ] &= ~( 1 << ( ScanCode & 7 ) );
+            return false;
+        }
+        PendingBreaks[ ScanCode >> 3 ] |= 1 << ( ScanCode & 7 );
+        bBreaksPending = true;
+        IKBD_SendPendingKeys();
+        return false;
     }
+
+    /* The IKBD doesn't auto-repeat keys (TOS does), so drop the PS/2 keyboard's */
+    /* typematic repeats of a key which is already down */
+    if ( IKBD_KeyDown ( ScanCode ) )
+        return false;
+
+    /* A press can't overtake a release still waiting. Nor is it dropped, */
+    /* as in scan code set 3 no repeat would come to retry it: it waits in */
+    /* PendingMakes[] */
+    IKBD_SetKeyDown ( ScanCode, true );                 /* Store the state of each ST scancode */
+    PendingMakes[ ScanCode >> 3 ] |= 1 << ( ScanCode & 7 );
+    bMakesPending = true;
+    IKBD_SendPendingKeys();
 #if 0
     /* If we're executing a custom IKBD program, call it to process the key event */
     if ( IKBD_ExeMode && pIKBD_CustomCodeHandler_Read )
         (*pIKBD_CustomCodeHandler_Read) ();
 #endif
+    return true;
 }
 
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Send the key codes of one bitmap of IKBD_PressSTKey(), as many as the
+ * output buffer has room for. Return false if some are still waiting.
+ */
+static bool IKBD_SendPendingBitmap ( uint8_t *Pending, uint8_t Release, bool bModifiers )
+{
+    int i;
+
+    for ( i = 0 ; i < 128 ; i++ ) {
+        if ( !( Pending[ i >> 3 ] & ( 1 << ( i & 7 ) ) ) )
+            continue;
+        if ( bModifiers && i != 0x1d && i != 0x2a && i != 0x36 && i != 0x38 )
+            continue;
+        if ( Keyboard.NbBytesInOutputBuffer >= SIZE_KEYBOARD_BUFFER )
+            return false;
+        Pending[ i >> 3 ] &= ~( 1 << ( i & 7 ) );
+        IKBD_Cmd_Return_Byte ( i | Release );
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Send the releases kept back by IKBD_PressSTKey(), then the presses. The
+ * presses of Control, Shift and Alt go first, as they were most likely
+ * pressed before the keys they modify.
+ */
+static void IKBD_SendPendingKeys(void)
+{
+    if ( bBreaksPending ) {
+        if ( !IKBD_SendPendingBitmap ( PendingBreaks, 0x80, false ) )
+            return;
+        bBreaksPending = false;
+    }
+    if ( bMakesPending ) {
+        if ( !IKBD_SendPendingBitmap ( PendingMakes, 0, true )
+                || !IKBD_SendPendingBitmap ( PendingMakes, 0, false ) )
+            return;
+        bMakesPending = false;
+    }
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return true if any ST key is down.
+ */
+bool IKBD_AnyKeyDown(void)
+{
+    int i;
+
+    for ( i = 0 ; i < 16 ; i++ )
+        if ( KeysDown[ i ] )
+            return true;
+    return false;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Release every key still down, after key events from the PS/2 keyboard
+ * were lost (receive ring overflow, keyboard unplugged or overrun). In scan
+ * code set 2, the keys really held come back with their next typematic
+ * repeat; in set 3, when pressed again.
+ */
+void IKBD_ReleaseAllKeys(void)
+{
+    int i, n = 0;
+
+    for ( i = 0 ; i < 128 ; i++ ) {
+        if ( IKBD_KeyDown ( i ) ) {
+            IKBD_PressSTKey ( i, false );
+            n++;
+        }
+    }
+    TRACE1 ( KEYS_RELEASED, n );
+}
+
 
 /*-----------------------------------------------------------------------*/
 /**
@@ -872,8 +1317,7 @@ static void IKBD_CheckResetDisableBug(void)
             KeyboardProcessor.JoystickMode = AUTOMODE_JOYSTICK;
             bBothMouseAndJoy = true;
 
-            LOG_TRACE(TRACE_IKBD_ALL, "ikbd cancel commands 0x12 and 0x1a received during reset,"
-                                      " enabling joystick and mouse reporting at the same time\n" );
+            TRACE(RESET_BUG_12_1A);
         }
     }
 }
@@ -893,6 +1337,9 @@ void IKBD_RunKeyboardCommand(uint8_t aciabyte)
 {
     int i=0;
 
+    PerfCounters.bytes_received++;
+    CAPTURE ( CAPTURE_HOST, aciabyte );
+
     /* Write into our keyboard input buffer if it's not full yet */
     if ( Keyboard.nBytesInInputBuffer < SIZE_KEYBOARDINPUT_BUFFER )
         Keyboard.InputBuffer[Keyboard.nBytesInInputBuffer++] = aciabyte;
@@ -907,8 +1354,12 @@ void IKBD_RunKeyboardCommand(uint8_t aciabyte)
                 /* Any new valid command will unpause the output (if command 0x13 was used) */
                 Keyboard.PauseOutput = false;
 
+                TRACE1(COMMAND, Keyboard.InputBuffer[0]);
                 CALL_VAR(KeyboardCommands[i].pCallFunction);
                 Keyboard.nBytesInInputBuffer = 0;       /* Clear input buffer after processing a command */
+
+                /* Keep what the host set up in case the MCU resets */
+                IKBD_MemorySnapShot_Capture ( true );
             }
 
             return;
@@ -941,8 +1392,6 @@ void IKBD_RunKeyboardCommand(uint8_t aciabyte)
  */
 static void IKBD_Cmd_Reset()
 {
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_Reset\n");
-
     /* Check that 0x01 was received after 0x80 */
     if (Keyboard.InputBuffer[1] == 0x01) {
         IKBD_Boot_ROM ( false );
@@ -968,7 +1417,7 @@ static void IKBD_Cmd_MouseAction()
     KeyboardProcessor.Mouse.Action = Keyboard.InputBuffer[1];
     KeyboardProcessor.Abs.PrevReadAbsMouseButtons = ABS_PREVBUTTONS;
 
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_MouseAction %d\n", KeyboardProcessor.Mouse.Action);
+    TRACE1(MOUSE_ACTION, KeyboardProcessor.Mouse.Action);
 }
 
 /*-----------------------------------------------------------------------*/
@@ -987,8 +1436,6 @@ static void IKBD_Cmd_RelMouseMode()
      * that the mouse has been enabled during reset. */
     if (bDuringResetCriticalTime)
         bMouseEnabledDuringReset = true;
-
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_RelMouseMode\n");
 }
 
 /*-----------------------------------------------------------------------*/
@@ -1005,11 +1452,11 @@ static void IKBD_Cmd_AbsMouseMode()
 {
     /* These maximums are 'inclusive' */
     KeyboardProcessor.MouseMode = AUTOMODE_MOUSEABS;
+    AbsButtonEdges = 0;
     KeyboardProcessor.Abs.MaxX = Keyboard.InputBuffer[1]<<8 | Keyboard.InputBuffer[2];
     KeyboardProcessor.Abs.MaxY = Keyboard.InputBuffer[3]<<8 | Keyboard.InputBuffer[4];
 
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_AbsMouseMode %d,%d\n",
-              KeyboardProcessor.Abs.MaxX, KeyboardProcessor.Abs.MaxY);
+    TRACE2(ABS_MOUSE_MODE, KeyboardProcessor.Abs.MaxX, KeyboardProcessor.Abs.MaxY);
 }
 
 /*-----------------------------------------------------------------------*/
@@ -1026,9 +1473,7 @@ static void IKBD_Cmd_MouseCursorKeycodes()
     KeyboardProcessor.Mouse.KeyCodeDeltaX = Keyboard.InputBuffer[1];
     KeyboardProcessor.Mouse.KeyCodeDeltaY = Keyboard.InputBuffer[2];
 
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_MouseCursorKeycodes %d,%d\n",
-              (int)KeyboardProcessor.Mouse.KeyCodeDeltaX,
-              (int)KeyboardProcessor.Mouse.KeyCodeDeltaY);
+    TRACE2(MOUSE_KEYCODES, KeyboardProcessor.Mouse.KeyCodeDeltaX, KeyboardProcessor.Mouse.KeyCodeDeltaY);
 }
 
 
@@ -1045,8 +1490,7 @@ static void IKBD_Cmd_SetMouseThreshold()
     KeyboardProcessor.Mouse.XThreshold = Keyboard.InputBuffer[1];
     KeyboardProcessor.Mouse.YThreshold = Keyboard.InputBuffer[2];
 
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_SetMouseThreshold %d,%d\n",
-              KeyboardProcessor.Mouse.XThreshold, KeyboardProcessor.Mouse.YThreshold);
+    TRACE2(MOUSE_THRESHOLD, KeyboardProcessor.Mouse.XThreshold, KeyboardProcessor.Mouse.YThreshold);
 }
 
 
@@ -1063,8 +1507,7 @@ static void IKBD_Cmd_SetMouseScale()
     KeyboardProcessor.Mouse.XScale = Keyboard.InputBuffer[1];
     KeyboardProcessor.Mouse.YScale = Keyboard.InputBuffer[2];
 
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_SetMouseScale %d,%d\n",
-              KeyboardProcessor.Mouse.XScale, KeyboardProcessor.Mouse.YScale);
+    TRACE2(MOUSE_SCALE, KeyboardProcessor.Mouse.XScale, KeyboardProcessor.Mouse.YScale);
 }
 
 /*-----------------------------------------------------------------------*/
@@ -1085,6 +1528,16 @@ static void IKBD_Cmd_SetMouseScale()
  *     YLSB
  */
 static void IKBD_Cmd_ReadAbsMousePos()
+{
+    IKBD_SendAbsMousePacket ( 18000-ACIA_CYCLES );
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Send the absolute mouse position packet of command 0x0D, the first byte
+ * after 'Delay_Cycles'.
+ */
+static void IKBD_SendAbsMousePacket ( int Delay_Cycles )
 {
     /* Test buttons */
     uint8_t Buttons = 0;
@@ -1101,10 +1554,13 @@ static void IKBD_Cmd_ReadAbsMousePos()
     const uint8_t PrevButtons = KeyboardProcessor.Abs.PrevReadAbsMouseButtons;
     KeyboardProcessor.Abs.PrevReadAbsMouseButtons = Buttons;
     Buttons &= ~PrevButtons;
+    /* Add the presses/releases that came and went since the last read */
+    Buttons |= AbsButtonEdges;
+    AbsButtonEdges = 0;
 
     /* And send packet */
     if ( IKBD_OutputBuffer_CheckFreeCount ( 6 ) ) {
-        IKBD_Cmd_Return_Byte_Delay (0xf7, 18000-ACIA_CYCLES);
+        IKBD_Cmd_Return_Byte_Delay (0xf7, Delay_Cycles);
         IKBD_Cmd_Return_Byte (Buttons);
         IKBD_Cmd_Return_Byte ((unsigned int)KeyboardProcessor.Abs.X>>8);
         IKBD_Cmd_Return_Byte ((unsigned int)KeyboardProcessor.Abs.X&0xff);
@@ -1112,8 +1568,7 @@ static void IKBD_Cmd_ReadAbsMousePos()
         IKBD_Cmd_Return_Byte ((unsigned int)KeyboardProcessor.Abs.Y&0xff);
     }
 
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_ReadAbsMousePos %d,%d 0x%X\n",
-              KeyboardProcessor.Abs.X, KeyboardProcessor.Abs.Y, Buttons);
+    TRACE3(READ_ABS_MOUSE, KeyboardProcessor.Abs.X, KeyboardProcessor.Abs.Y, Buttons);
 }
 
 /*-----------------------------------------------------------------------*/
@@ -1133,8 +1588,7 @@ static void IKBD_Cmd_SetInternalMousePos()
     KeyboardProcessor.Abs.X = Keyboard.InputBuffer[2]<<8 | Keyboard.InputBuffer[3];
     KeyboardProcessor.Abs.Y = Keyboard.InputBuffer[4]<<8 | Keyboard.InputBuffer[5];
 
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_SetInternalMousePos %d,%d\n",
-              KeyboardProcessor.Abs.X, KeyboardProcessor.Abs.Y);
+    TRACE2(SET_MOUSE_POSITION, KeyboardProcessor.Abs.X, KeyboardProcessor.Abs.Y);
 }
 
 
@@ -1152,7 +1606,6 @@ static void IKBD_Cmd_SetYAxisDown()
      * a way to change it.
      */
     KeyboardProcessor.Mouse.YAxis = 1;
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_SetYAxisDown\n");
 }
 
 
@@ -1170,7 +1623,6 @@ static void IKBD_Cmd_SetYAxisUp()
      * a way to change it.
      */
     KeyboardProcessor.Mouse.YAxis = -1;
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_SetYAxisUp\n");
 }
 
 
@@ -1185,7 +1637,6 @@ static void IKBD_Cmd_SetYAxisUp()
  */
 static void IKBD_Cmd_StartKeyboardTransfer()
 {
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_StartKeyboardTransfer\n");
     Keyboard.PauseOutput = false;
 }
 
@@ -1200,7 +1651,6 @@ static void IKBD_Cmd_TurnMouseOff()
     KeyboardProcessor.MouseMode = AUTOMODE_OFF;
     bMouseDisabled = true;
 
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_TurnMouseOff\n");
 
     IKBD_CheckResetDisableBug();
 }
@@ -1216,11 +1666,10 @@ static void IKBD_Cmd_StopKeyboardTransfer()
 {
     if (bDuringResetCriticalTime) {
         /* Required for the loader of 'Just Bugging' by ACF */
-        LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_StopKeyboardTransfer ignored during ikbd reset\n");
+        TRACE(STOP_TRANSFER_IGNORED);
         return;
     }
 
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_StopKeyboardTransfer\n");
     Keyboard.PauseOutput = true;
 }
 
@@ -1232,8 +1681,6 @@ static void IKBD_Cmd_StopKeyboardTransfer()
  */
 static void IKBD_Cmd_ReturnJoystickAuto()
 {
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_ReturnJoystickAuto\n");
-
     KeyboardProcessor.JoystickMode = AUTOMODE_JOYSTICK;
     KeyboardProcessor.MouseMode = AUTOMODE_OFF;
 
@@ -1242,16 +1689,14 @@ static void IKBD_Cmd_ReturnJoystickAuto()
     if ( bDuringResetCriticalTime && bMouseEnabledDuringReset ) {
         KeyboardProcessor.MouseMode = AUTOMODE_MOUSEREL;
         bBothMouseAndJoy = true;
-        LOG_TRACE(TRACE_IKBD_ALL, "ikbd commands 0x08 and 0x14 received during reset,"
-                                  " enabling joystick and mouse reporting at the same time\n" );
+        TRACE(RESET_BUG_08_14);
     }
     /* If mouse was disabled during the reset (0x12 command) it is enabled again
      * (used by the game Hammerfist for example) */
     else if ( bDuringResetCriticalTime && bMouseDisabled ) {
         KeyboardProcessor.MouseMode = AUTOMODE_MOUSEREL;
         bBothMouseAndJoy = true;
-        LOG_TRACE(TRACE_IKBD_ALL, "ikbd commands 0x12 and 0x14 received during reset,"
-                                  " enabling joystick and mouse reporting at the same time\n" );
+        TRACE(RESET_BUG_12_14);
     }
 
     /* This command resets the internally previously stored joystick states */
@@ -1275,7 +1720,6 @@ static void IKBD_Cmd_ReturnJoystickAuto()
 static void IKBD_Cmd_StopJoystick(void)
 {
     KeyboardProcessor.JoystickMode = AUTOMODE_OFF;
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_StopJoystick\n");
 }
 
 
@@ -1287,8 +1731,6 @@ static void IKBD_Cmd_StopJoystick(void)
  */
 static void IKBD_Cmd_ReturnJoystick(void)
 {
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_ReturnJoystick\n");
-
     if ( IKBD_OutputBuffer_CheckFreeCount ( 3 ) ) {
         IKBD_Cmd_Return_Byte_Delay ( 0xFD, IKBD_Delay_Random ( 7500, 10000 ) );
         IKBD_Cmd_Return_Byte (Joy_GetStickData(JOYID_JOYSTICK0));
@@ -1321,7 +1763,7 @@ static void IKBD_Cmd_SetJoystickMonitoring(void)
     KeyboardProcessor.JoystickMode = AUTOMODE_JOYSTICK_MONITORING;
     KeyboardProcessor.MouseMode = AUTOMODE_OFF;
 
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_SetJoystickMonitoring %d\n" , Rate );
+    TRACE1(JOYSTICK_MONITORING, Rate);
 
     if ( Rate == 0 )
         Rate = 1;
@@ -1344,7 +1786,7 @@ static void IKBD_Cmd_SetJoystickMonitoring(void)
  */
 static void IKBD_Cmd_SetJoystickFireDuration(void)
 {
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_SetJoystickFireDuration (not implemented)\n");
+    TRACE1(NOT_IMPLEMENTED, 0x18);
 }
 
 /*-----------------------------------------------------------------------*/
@@ -1371,7 +1813,7 @@ static void IKBD_Cmd_SetJoystickFireDuration(void)
  */
 static void IKBD_Cmd_SetCursorForJoystick(void)
 {
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_SetCursorForJoystick (not implemented)\n");
+    TRACE1(NOT_IMPLEMENTED, 0x19);
 }
 
 /*-----------------------------------------------------------------------*/
@@ -1385,7 +1827,6 @@ static void IKBD_Cmd_DisableJoysticks(void)
     KeyboardProcessor.JoystickMode = AUTOMODE_OFF;
     bJoystickDisabled = true;
 
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_DisableJoysticks\n");
 
     IKBD_CheckResetDisableBug();
 }
@@ -1402,8 +1843,6 @@ static void IKBD_Cmd_DisableJoysticks(void)
  */
 static void IKBD_Cmd_ReportMouseAction(void)
 {
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_ReportMouseAction\n");
-
     if ( IKBD_OutputBuffer_CheckFreeCount ( 8 ) ) {
         IKBD_Cmd_Return_Byte_Delay ( 0xF6, IKBD_Delay_Random ( 7000, 7500 ) );
         IKBD_Cmd_Return_Byte (7);
@@ -1425,8 +1864,6 @@ static void IKBD_Cmd_ReportMouseAction(void)
  */
 static void IKBD_Cmd_ReportMouseMode(void)
 {
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_ReportMouseMode\n");
-
     if ( IKBD_OutputBuffer_CheckFreeCount ( 8 ) ) {
         IKBD_Cmd_Return_Byte_Delay ( 0xF6, IKBD_Delay_Random ( 7000, 7500 ) );
         switch (KeyboardProcessor.MouseMode) {
@@ -1471,8 +1908,6 @@ static void IKBD_Cmd_ReportMouseMode(void)
  */
 static void IKBD_Cmd_ReportMouseThreshold(void)
 {
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_ReportMouseThreshold\n");
-
     if ( IKBD_OutputBuffer_CheckFreeCount ( 8 ) ) {
         IKBD_Cmd_Return_Byte_Delay ( 0xF6, IKBD_Delay_Random ( 7000, 7500 ) );
         IKBD_Cmd_Return_Byte (0x0B);
@@ -1494,8 +1929,6 @@ static void IKBD_Cmd_ReportMouseThreshold(void)
  */
 static void IKBD_Cmd_ReportMouseScale(void)
 {
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_ReportMouseScale\n");
-
     if ( IKBD_OutputBuffer_CheckFreeCount ( 8 ) ) {
         IKBD_Cmd_Return_Byte_Delay ( 0xF6, IKBD_Delay_Random ( 7000, 7500 ) );
         IKBD_Cmd_Return_Byte (0x0C);
@@ -1517,8 +1950,6 @@ static void IKBD_Cmd_ReportMouseScale(void)
  */
 static void IKBD_Cmd_ReportMouseVertical(void)
 {
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_ReportMouseVertical\n");
-
     if ( IKBD_OutputBuffer_CheckFreeCount ( 8 ) ) {
         IKBD_Cmd_Return_Byte_Delay ( 0xF6, IKBD_Delay_Random ( 7000, 7500 ) );
         if (KeyboardProcessor.Mouse.YAxis == -1)
@@ -1543,8 +1974,6 @@ static void IKBD_Cmd_ReportMouseVertical(void)
  */
 static void IKBD_Cmd_ReportMouseAvailability(void)
 {
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_ReportMouseAvailability\n");
-
     if ( IKBD_OutputBuffer_CheckFreeCount ( 8 ) ) {
         IKBD_Cmd_Return_Byte_Delay ( 0xF6, IKBD_Delay_Random ( 7000, 7500 ) );
         if (KeyboardProcessor.MouseMode == AUTOMODE_OFF)
@@ -1569,8 +1998,6 @@ static void IKBD_Cmd_ReportMouseAvailability(void)
  */
 static void IKBD_Cmd_ReportJoystickMode(void)
 {
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_ReportJoystickMode\n");
-
     if ( IKBD_OutputBuffer_CheckFreeCount ( 8 ) ) {
         IKBD_Cmd_Return_Byte_Delay ( 0xF6, IKBD_Delay_Random ( 7000, 7500 ) );
         switch (KeyboardProcessor.JoystickMode) {
@@ -1605,8 +2032,6 @@ static void IKBD_Cmd_ReportJoystickMode(void)
  */
 static void IKBD_Cmd_ReportJoystickAvailability(void)
 {
-    LOG_TRACE(TRACE_IKBD_CMDS, "IKBD_Cmd_ReportJoystickAvailability\n");
-
     if ( IKBD_OutputBuffer_CheckFreeCount ( 8 ) ) {
         IKBD_Cmd_Return_Byte_Delay ( 0xF6, IKBD_Delay_Random ( 7000, 7500 ) );
         if (KeyboardProcessor.JoystickMode == AUTOMODE_OFF)
@@ -1625,3 +2050,657 @@ static void IKBD_Cmd_ReportJoystickAvailability(void)
 /************************************************************************/
 /* End of the IKBD's commands emulation.				*/
 /************************************************************************/
+
+
+/************************************************************************/
+/* KEMOJO extensions. These commands are NOPs on a real IKBD, so stock  */
+/* ST software never uses them. Reports use the 0xF6 status header      */
+/* followed by the command number, like the IKBD's own reports.         */
+/************************************************************************/
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * SET PS/2 MOUSE PARAMETERS
+ *
+ * 0x30
+ * rate      ; sample rate in samples/s (10, 20, 40, 60, 80, 100 or 200)
+ * res       ; resolution, 0 = 1, 1 = 2, 2 = 4, 3 = 8 counts/mm
+ * scaling   ; 0 = 1:1, 1 = 2:1
+ * mode      ; 0 = stream mode, 1 = remote mode (mouse polled once per report tick)
+ *
+ * Invalid values leave the corresponding setting unchanged.
+ */
+static void IKBD_Cmd_SetPS2MouseParams(void)
+{
+    const uint8_t Rate = Keyboard.InputBuffer[1];
+
+    switch (Rate) {
+    case 10: case 20: case 40: case 60: case 80: case 100: case 200:
+        MouseConfig.SampleRate = Rate;
+        break;
+    default: ;
+    }
+    if (Keyboard.InputBuffer[2] <= 3)
+        MouseConfig.Resolution = Keyboard.InputBuffer[2];
+    if (Keyboard.InputBuffer[3] <= 1)
+        MouseConfig.Scaling = Keyboard.InputBuffer[3];
+    if (Keyboard.InputBuffer[4] <= 1)
+        MouseConfig.RemoteMode = Keyboard.InputBuffer[4];
+
+    TRACE2(PS2_MOUSE_PARAMS, TRACE_BYTES(MouseConfig.SampleRate, MouseConfig.Resolution),
+           TRACE_BYTES(MouseConfig.Scaling, MouseConfig.RemoteMode));
+
+    Mouse_ApplyConfig();
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * REPORT PS/2 MOUSE PARAMETERS
+ *
+ * 0xB0
+ *   Returns:  0xF6 0x30 rate res scaling mode 0 0
+ */
+static void IKBD_Cmd_ReportPS2MouseParams(void)
+{
+    if ( IKBD_OutputBuffer_CheckFreeCount ( 8 ) ) {
+        IKBD_Cmd_Return_Byte (0xF6);
+        IKBD_Cmd_Return_Byte (0x30);
+        IKBD_Cmd_Return_Byte (MouseConfig.SampleRate);
+        IKBD_Cmd_Return_Byte (MouseConfig.Resolution);
+        IKBD_Cmd_Return_Byte (MouseConfig.Scaling);
+        IKBD_Cmd_Return_Byte (MouseConfig.RemoteMode);
+        IKBD_Cmd_Return_Byte (0);
+        IKBD_Cmd_Return_Byte (0);
+    }
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * SET KEYBOARD LEDS
+ *
+ * 0x31
+ * leds      ; bit 0 Scroll Lock, bit 1 Num Lock, bit 2 Caps Lock
+ * mode      ; 0 = Caps Lock presses also toggle the Caps Lock LED
+ *           ; 1 = LEDs only change with this command
+ */
+static void IKBD_Cmd_SetKeyboardLeds(void)
+{
+    KeyboardLeds.Leds = Keyboard.InputBuffer[1] & 0x07;
+    KeyboardLeds.HostControl = Keyboard.InputBuffer[2] ? 1 : 0;
+
+    TRACE2(KEYBOARD_LEDS, KeyboardLeds.Leds, KeyboardLeds.HostControl);
+
+    Keyboard_ApplyLeds();
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * REPORT KEYBOARD LEDS
+ *
+ * 0xB1
+ *   Returns:  0xF6 0x31 leds mode 0 0 0 0
+ */
+static void IKBD_Cmd_ReportKeyboardLeds(void)
+{
+    if ( IKBD_OutputBuffer_CheckFreeCount ( 8 ) ) {
+        IKBD_Cmd_Return_Byte (0xF6);
+        IKBD_Cmd_Return_Byte (0x31);
+        IKBD_Cmd_Return_Byte (KeyboardLeds.Leds);
+        IKBD_Cmd_Return_Byte (KeyboardLeds.HostControl);
+        IKBD_Cmd_Return_Byte (0);
+        IKBD_Cmd_Return_Byte (0);
+        IKBD_Cmd_Return_Byte (0);
+        IKBD_Cmd_Return_Byte (0);
+    }
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * CLEAR PERFORMANCE COUNTERS
+ *
+ * 0x32
+ */
+static void IKBD_Cmd_ClearPerfCounters(void)
+{
+    const uint8_t state = hal_irq_save();
+    memset ( (void *)&PerfCounters, 0, sizeof(PerfCounters) );
+    hal_irq_restore(state);
+}
+
+
+/* Store 'Bytes' bytes of 'Value', most significant first */
+static uint8_t *IKBD_PutBigEndian ( uint8_t *p, uint32_t Value, int Bytes )
+{
+    while ( Bytes-- > 0 )
+        *p++ = Value >> ( 8 * Bytes );
+    return p;
+}
+
+/* Send a block of 'Len' bytes, a multiple of 5, as packets */
+/* 0xF6 Command n d0 d1 d2 d3 d4 carrying bytes 5n to 5n+4 */
+static void IKBD_ReturnBlock ( uint8_t Command, const uint8_t *Block, int Len )
+{
+    int n, i;
+
+    for ( n = 0 ; 5*n < Len ; n++ ) {
+        IKBD_Cmd_Return_Byte (0xF6);
+        IKBD_Cmd_Return_Byte (Command);
+        IKBD_Cmd_Return_Byte (n);
+        for ( i = 0 ; i < 5 ; i++ )
+            IKBD_Cmd_Return_Byte (Block[5*n+i]);
+    }
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * REPORT PERFORMANCE COUNTERS
+ *
+ * 0xB2
+ *   Returns:  6 packets 0xF6 0x32 n d0 d1 d2 d3 d4, n = 0 to 5, carrying
+ *             bytes 5n to 5n+4 of this block (big endian):
+ *     0  keyboard ring overflows      2  mouse ring overflows
+ *     4  keyboard parity errors       6  mouse parity errors
+ *     8  keyboard framing errors     10  mouse framing errors
+ *    12  keyboard ring high-water    13  mouse ring high-water (1 byte)
+ *    14  packets dropped             16  output buffer high-water
+ *    18  bytes received (4 bytes)    22  bytes sent (4 bytes)
+ *    26  0 0 0 0
+ */
+static void IKBD_Cmd_ReportPerfCounters(void)
+{
+    PERF_COUNTERS Counters;
+    uint8_t Block[30];
+    uint8_t *p = Block;
+    int i;
+
+
+    if ( !IKBD_OutputBuffer_CheckFreeCount ( 6*8 ) )
+        return;
+
+    const uint8_t state = hal_irq_save();
+    memcpy ( &Counters, (const void *)&PerfCounters, sizeof(Counters) );
+    hal_irq_restore(state);
+
+    for ( i = PERF_KEYBOARD ; i <= PERF_MOUSE ; i++ )
+        p = IKBD_PutBigEndian ( p, Counters.ps2_overflows[i], 2 );
+    for ( i = PERF_KEYBOARD ; i <= PERF_MOUSE ; i++ )
+        p = IKBD_PutBigEndian ( p, Counters.ps2_parity_errors[i], 2 );
+    for ( i = PERF_KEYBOARD ; i <= PERF_MOUSE ; i++ )
+        p = IKBD_PutBigEndian ( p, Counters.ps2_framing_errors[i], 2 );
+    for ( i = PERF_KEYBOARD ; i <= PERF_MOUSE ; i++ )
+        *p++ = Counters.ps2_ring_high[i];
+    p = IKBD_PutBigEndian ( p, Counters.packets_dropped, 2 );
+    p = IKBD_PutBigEndian ( p, Counters.output_high, 2 );
+    p = IKBD_PutBigEndian ( p, Counters.bytes_received, 4 );
+    p = IKBD_PutBigEndian ( p, Counters.bytes_sent, 4 );
+    memset ( p, 0, Block + sizeof(Block) - p );
+
+    IKBD_ReturnBlock ( 0x32, Block, sizeof(Block) );
+}
+
+
+#if PROFILE_BUILD
+/*-----------------------------------------------------------------------*/
+/**
+ * CLEAR PROFILER HISTOGRAMS
+ *
+ * 0x33
+ */
+static void IKBD_Cmd_ClearProfile(void)
+{
+    profile_clear();
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * REPORT PROFILER HISTOGRAM
+ *
+ * 0xB3
+ * id        ; histogram, PROFILE_xxx in profile.h
+ *   Returns:  6 packets 0xF6 0x33 n d0 d1 d2 d3 d4, n = 0 to 5, carrying
+ *             bytes 5n to 5n+4 of this block (big endian):
+ *     0  12 bucket counts (2 bytes each)
+ *    24  longest time in ticks
+ *    26  tick length in ns / 10
+ *    28  id, 0
+ */
+static void IKBD_Cmd_ReportProfile(void)
+{
+    const uint8_t Id = Keyboard.InputBuffer[1];
+    uint16_t Buckets[PROFILE_BUCKETS], Max;
+    uint8_t Block[30];
+    uint8_t *p = Block;
+    int i;
+
+    if ( Id >= PROFILE_COUNT || !IKBD_OutputBuffer_CheckFreeCount ( 6*8 ) )
+        return;
+
+    profile_read ( Id, Buckets, &Max );
+    for ( i = 0 ; i < PROFILE_BUCKETS ; i++ )
+        p = IKBD_PutBigEndian ( p, Buckets[i], 2 );
+    p = IKBD_PutBigEndian ( p, Max, 2 );
+    p = IKBD_PutBigEndian ( p, PROFILE_TICK_NS / 10, 2 );
+    *p++ = Id;
+    *p++ = 0;
+
+    IKBD_ReturnBlock ( 0x33, Block, sizeof(Block) );
+}
+#endif
+
+
+#if TRACE_ENA || CAPTURE_ENA
+/*-----------------------------------------------------------------------*/
+/**
+ * Empty a ring of fixed size entries (trace, capture) into packets
+ * 0xF6 Command n d0 d1 d2 d3 d4, n = 0, 1, ..., carrying bytes 5n to 5n+4
+ * of this block (big endian), zero padded:
+ *     0  number of entries that follow
+ *     1  entries lost since the last report
+ *     3  entries, oldest first
+ * Only as many entries as fit in the output buffer are taken.
+ */
+static void IKBD_Cmd_ReturnRing ( uint8_t Command, int Count, int EntrySize,
+                                  uint16_t (*TakeLost)(void), bool (*Pop)(uint8_t *) )
+{
+    uint8_t Packet[5+8];                                /* Up to 8 byte entries */
+    int Room, Size, n, i;
+
+    /* Whole packets left in the output buffer, less the block header */
+    Room = ( SIZE_KEYBOARD_BUFFER - Keyboard.NbBytesInOutputBuffer ) / 8 * 5 - 3;
+    if ( Room < 0 ) {
+        TRACE1 ( OUTPUT_FULL, 8 );
+        return;
+    }
+    if ( Count > Room / EntrySize )
+        Count = Room / EntrySize;
+
+    Packet[0] = Count;
+    IKBD_PutBigEndian ( Packet+1, TakeLost(), 2 );
+    Size = 3;
+    for ( n = 0 ; Size > 0 || Count > 0 ; n++ ) {
+        /* Refill with the next entries, or pad the last packet */
+        while ( Size < 5 && Count > 0 ) {
+            Pop ( Packet+Size );
+            Size += EntrySize;
+            Count--;
+        }
+        for ( i = Size ; i < 5 ; i++ )
+            Packet[i] = 0;
+
+        IKBD_Cmd_Return_Byte (0xF6);
+        IKBD_Cmd_Return_Byte (Command);
+        IKBD_Cmd_Return_Byte (n);
+        for ( i = 0 ; i < 5 ; i++ )
+            IKBD_Cmd_Return_Byte (Packet[i]);
+
+        Size = Size > 5 ? Size - 5 : 0;
+        memmove ( Packet, Packet+5, Size );
+    }
+}
+#endif
+
+
+#if TRACE_ENA
+/*-----------------------------------------------------------------------*/
+/**
+ * CLEAR EVENT TRACE
+ *
+ * 0x34
+ */
+static void IKBD_Cmd_ClearTrace(void)
+{
+    trace_clear();
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * REPORT EVENT TRACE
+ *
+ * 0xB4
+ *   Returns:  packets 0xF6 0x34 n d0 d1 d2 d3 d4 (see IKBD_Cmd_ReturnRing)
+ *             with events of 8 bytes: time in ms (2), id, a (2), b (2), c.
+ *   Reported events are removed from the trace. Events that don't fit in
+ *   the output buffer are left for the next report.
+ */
+static void IKBD_Cmd_ReportTrace(void)
+{
+    IKBD_Cmd_ReturnRing ( 0x34, trace_count(), TRACE_ENTRY_SIZE, trace_take_lost, trace_pop );
+}
+#endif
+
+
+#if CAPTURE_ENA
+/*-----------------------------------------------------------------------*/
+/**
+ * SET INPUT CAPTURE MODE
+ *
+ * 0x35
+ * mode      ; 0 off, 1 until the capture is full, 2 continuous (CAPTURE_xxx)
+ *
+ * Empties the capture and starts recording in the new mode.
+ */
+static void IKBD_Cmd_SetCaptureMode(void)
+{
+    capture_set_mode ( Keyboard.InputBuffer[1] );
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * REPORT INPUT CAPTURE
+ *
+ * 0xB5
+ *   Returns:  packets 0xF6 0x35 n d0 d1 d2 d3 d4 (see IKBD_Cmd_ReturnRing)
+ *             with inputs of 4 bytes: time in ms (2), source, value.
+ *   Reported inputs are removed from the capture. Inputs that don't fit in
+ *   the output buffer are left for the next report.
+ */
+static void IKBD_Cmd_ReportCapture(void)
+{
+    IKBD_Cmd_ReturnRing ( 0x35, capture_count(), CAPTURE_ENTRY_SIZE, capture_take_lost, capture_pop );
+}
+#endif
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * CHANGE SETTING
+ *
+ * 0x36
+ * field     ; SETTING_xxx in settings.h
+ * value     ; 3 bytes, big endian
+ *
+ * Out of range values are ignored. The change is not saved until command
+ * 0x37 0, and only the report interval and the keyboard layout are used
+ * before the next power up (settings_boot()).
+ */
+static void IKBD_Cmd_SetSetting(void)
+{
+    const uint32_t Value = (uint32_t)Keyboard.InputBuffer[2] << 16
+                         | (uint32_t)Keyboard.InputBuffer[3] << 8
+                         | Keyboard.InputBuffer[4];
+    const uint8_t Layout = Settings.keyboard_layout;
+
+    settings_set ( Keyboard.InputBuffer[1], Value );
+    /* Held keys would be released as other ST keys */
+    if ( Settings.keyboard_layout != Layout )
+        remap_release_all();
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * SAVE, RELOAD OR RESET SETTINGS AND KEY MAP
+ *
+ * 0x37
+ * action    ; 0 save to EEPROM, 1 reload from EEPROM, 2 back to defaults
+ *
+ * Saving goes on in the background; 0xB6 tells when it is done.
+ */
+static void IKBD_Cmd_Settings(void)
+{
+    switch (Keyboard.InputBuffer[1]) {
+    case 0:
+        settings_save();
+        remap_save();
+        break;
+    case 1:
+        settings_load();
+        remap_load();
+        remap_release_all();                /* the layout or map may change */
+        break;
+    case 2:
+        settings_defaults();
+        remap_clear();
+        remap_release_all();
+        break;
+    default: ;
+    }
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * REPORT SETTINGS
+ *
+ * 0xB6
+ *   Returns:  3 packets 0xF6 0x36 n d0 d1 d2 d3 d4, n = 0 to 2, carrying
+ *             bytes 5n to 5n+4 of this block (big endian):
+ *     0  SETTINGS_VERSION
+ *     1  source, SETTINGS_FROM_xxx in settings.h, bit 7 set while saving
+ *        the settings or the key map
+ *     2  sequence number of the slot last loaded or saved
+ *     3  baud rate (3), PS/2 timeout in ms (2), flags, report interval
+ *        in ms, mouse sample rate, resolution, scaling, remote mode,
+ *        keyboard layout
+ */
+static void IKBD_Cmd_ReportSettings(void)
+{
+    uint8_t Block[15];
+
+    if ( !IKBD_OutputBuffer_CheckFreeCount ( 3*8 ) )
+        return;
+
+    Block[0] = SETTINGS_VERSION;
+    Block[1] = settings_source() | ( settings_saving() || remap_saving() ? 0x80 : 0 );
+    Block[2] = settings_sequence();
+    settings_serialize ( Block+3 );
+
+    IKBD_ReturnBlock ( 0x36, Block, sizeof(Block) );
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * REMAP KEY
+ *
+ * 0x38
+ * key       ; ST scan code, or from KEY_PS2_ONLY up a PS/2 key the ST
+ *             doesn't have (keys.h)
+ * target    ; 0 unchanged, ST scan code to send instead, REMAP_OFF to
+ *             drop the key, REMAP_MACRO + n to play macro n
+ *
+ * Invalid keys and targets are ignored. Saved with command 0x37 0. A new
+ * target releases the keys held, as remap_release_all() does.
+ */
+static void IKBD_Cmd_SetKeyMap(void)
+{
+    remap_set_key ( Keyboard.InputBuffer[1], Keyboard.InputBuffer[2] );
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * REPORT KEY MAPPING
+ *
+ * 0xB8
+ * key
+ *   Returns:  0xF6 0x38 key target 0 0 0 0
+ */
+static void IKBD_Cmd_ReportKeyMap(void)
+{
+    const uint8_t Key = Keyboard.InputBuffer[1];
+    int i;
+
+    if ( !IKBD_OutputBuffer_CheckFreeCount ( 8 ) )
+        return;
+
+    IKBD_Cmd_Return_Byte (0xF6);
+    IKBD_Cmd_Return_Byte (0x38);
+    IKBD_Cmd_Return_Byte (Key);
+    IKBD_Cmd_Return_Byte (remap_get_key(Key));
+    for ( i = 0 ; i < 4 ; i++ )
+        IKBD_Cmd_Return_Byte (0);
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * SET MACRO
+ *
+ * 0x39
+ * n         ; macro number, 0 to REMAP_MACROS-1
+ * s0 .. s4  ; steps: ST scan code to press and release, or with
+ *             REMAP_HOLD to hold until the end of the macro; 0 ends
+ *
+ * Invalid macros are ignored. Saved with command 0x37 0.
+ */
+static void IKBD_Cmd_SetMacro(void)
+{
+    remap_set_macro ( Keyboard.InputBuffer[1], &Keyboard.InputBuffer[2] );
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * REPORT MACRO
+ *
+ * 0xB9
+ * n
+ *   Returns:  0xF6 0x39 n s0 s1 s2 s3 s4
+ */
+static void IKBD_Cmd_ReportMacro(void)
+{
+    const uint8_t n = Keyboard.InputBuffer[1];
+    uint8_t Steps[REMAP_MACRO_SIZE];
+    int i;
+
+    if ( !IKBD_OutputBuffer_CheckFreeCount ( 8 ) )
+        return;
+
+    remap_get_macro ( n, Steps );
+    IKBD_Cmd_Return_Byte (0xF6);
+    IKBD_Cmd_Return_Byte (0x39);
+    IKBD_Cmd_Return_Byte (n);
+    for ( i = 0 ; i < REMAP_MACRO_SIZE ; i++ )
+        IKBD_Cmd_Return_Byte (Steps[i]);
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * CLEAR WATCHDOG COUNTS
+ *
+ * 0x3A
+ */
+static void IKBD_Cmd_ClearWatchdog(void)
+{
+    watchdog_clear();
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * REPORT WATCHDOG COUNTS
+ *
+ * 0xBA
+ *   Returns:  5 packets 0xF6 0x3A n d0 d1 d2 d3 d4, n = 0 to 4, carrying
+ *             bytes 5n to 5n+4 of this block:
+ *     0  last reset cause (HAL_RESET_xxx)
+ *     1  stage that stalled before it (WATCHDOG_xxx), 0xFF if none
+ *     2  watchdog resets since power up
+ *     3  stalls of each of the WATCHDOG_STAGES stages (2 bytes each, big
+ *        endian), then 0 0
+ */
+static void IKBD_Cmd_ReportWatchdog(void)
+{
+    uint8_t Block[25];
+    uint8_t *p = Block;
+    int i;
+
+    if ( !IKBD_OutputBuffer_CheckFreeCount ( 5*8 ) )
+        return;
+
+    *p++ = hal_reset_cause();
+    *p++ = watchdog_stalled();
+    *p++ = watchdog_resets();
+    for ( i = 0 ; i < WATCHDOG_STAGES ; i++ )
+        p = IKBD_PutBigEndian ( p, watchdog_count ( i ), 2 );
+    while ( p < Block + sizeof(Block) )
+        *p++ = 0;
+
+    IKBD_ReturnBlock ( 0x3A, Block, sizeof(Block) );
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * REPORT KEY STATE
+ *
+ * 0xBB
+ *   Returns:  4 packets 0xF6 0x3B n d0 d1 d2 d3 d4, n = 0 to 3, carrying
+ *             bytes 5n to 5n+4 of this block:
+ *     0  keys down, 16 bytes: bit k of byte i is ST scancode 8*i+k
+ *    16  mouse buttons, bit 1 left and bit 0 right as in 0xF8-0xFB
+ *    17  joystick 0 and 18 joystick 1, as in 0xFD
+ *    19  0
+ *
+ * Lets the host pick up the state after a reset of its own without
+ * waiting for new events.
+ */
+static void IKBD_Cmd_ReportKeyState(void)
+{
+    uint8_t Block[20];
+
+    if ( !IKBD_OutputBuffer_CheckFreeCount ( 4*8 ) )
+        return;
+
+    memcpy ( Block, KeysDown, sizeof(KeysDown) );
+    Block[16] = ( Keyboard.bLButtonDown ? 2 : 0 ) | ( Keyboard.bRButtonDown ? 1 : 0 );
+    Block[17] = Joy_GetStickData ( JOYID_JOYSTICK0 );
+    Block[18] = Joy_GetStickData ( JOYID_JOYSTICK1 );
+    Block[19] = 0;
+
+    IKBD_ReturnBlock ( 0x3B, Block, sizeof(Block) );
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * SET MOUSE OPTIONS
+ *
+ * 0x3C
+ * options   ; bit 0: relative motion as 0x7C | buttons, X (2 bytes),
+ *             Y (2 bytes) instead of 0xF8-0xFB packets
+ *             bit 1: in absolute mode, send the 0x0D packet unasked, at
+ *             most once per report tick, when the position or the
+ *             buttons change, clicks between two ticks included
+ *
+ * Unknown bits are ignored. A reset (0x80 0x01) clears the options.
+ */
+static void IKBD_Cmd_SetMouseOptions(void)
+{
+    MouseOptions = Keyboard.InputBuffer[1] & MOUSE_OPTIONS;
+    /* Start with the current position */
+    AbsPushedX = AbsPushedY = -1;
+    AbsButtonEdges = 0;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * REPORT MOUSE OPTIONS
+ *
+ * 0xBC
+ *   Returns:  0xF6 0x3C options 0 0 0 0 0
+ */
+static void IKBD_Cmd_ReportMouseOptions(void)
+{
+    if ( IKBD_OutputBuffer_CheckFreeCount ( 8 ) ) {
+        IKBD_Cmd_Return_Byte (0xF6);
+        IKBD_Cmd_Return_Byte (0x3C);
+        IKBD_Cmd_Return_Byte (MouseOptions);
+        IKBD_Cmd_Return_Byte (0);
+        IKBD_Cmd_Return_Byte (0);
+        IKBD_Cmd_Return_Byte (0);
+        IKBD_Cmd_Return_Byte (0);
+        IKBD_Cmd_Return_Byte (0);
+    }
+}
@@ -11,6 +11,7 @@
 #define HATARI_IKBD_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 /* Keyboard processor details */
@@ -97,8 +98,24 @@ enum {
 #define ACIA_STATUS_REGISTER__OVERRUN_ERROR    0x20
 #define ACIA_STATUS_REGISTER__INTERRUPT_REQUEST  0x80
 
+/* PS/2 mouse settings (KEMOJO extension, see command 0x30) */
+typedef struct {
+    uint8_t SampleRate;             /* Samples per second */
+    uint8_t Resolution;             /* 0-3 : 1, 2, 4 or 8 counts/mm */
+    uint8_t Scaling;                /* 0 = 1:1, 1 = 2:1 */
+    uint8_t RemoteMode;             /* If set, the mouse is polled once per report tick */
+} PS2_MOUSE_CONFIG;
+
+/* PS/2 keyboard LEDs (KEMOJO extension, see command 0x31) */
+typedef struct {
+    uint8_t Leds;                   /* Bit 0 Scroll Lock, bit 1 Num Lock, bit 2 Caps Lock */
+    uint8_t HostControl;            /* If set, Caps Lock presses don't toggle the LED */
+} KEYBOARD_LEDS;
+
 extern KEYBOARD_PROCESSOR KeyboardProcessor;
 extern KEYBOARD Keyboard;
+extern PS2_MOUSE_CONFIG MouseConfig;
+extern KEYBOARD_LEDS KeyboardLeds;
 
 #ifdef __cplusplus
 extern "C" {
@@ -107,12 +124,15 @@ extern void IKBD_Reset(bool bCold);
 
 extern void IKBD_MemorySnapShot_Capture(bool bSave);
 
-//extern void IKBD_InterruptHandler_ResetTimer();
+extern void IKBD_InterruptHandler_ResetTimer(void);
 extern void IKBD_InterruptHandler_AutoSend();
 
 extern void IKBD_UpdateClockOnVBL();
 
-extern void IKBD_PressSTKey(uint8_t ScanCode, bool bPress);
+extern bool IKBD_PressSTKey(uint8_t ScanCode, bool bPress);
+extern void IKBD_ReleaseAllKeys(void);
+extern bool IKBD_AnyKeyDown(void);
+extern void IKBD_SetMouseButtons(bool bLeft, bool bRight);
 
 extern void IKBD_Info(FILE *fp, uint32_t dummy);
 
@@ -120,6 +140,8 @@ extern void IKBD_RunKeyboardCommand(uint8_t aciabyte);
 
 extern void IKBD_SendAutoKeyboardCommands(void);
 
+extern int IKBD_OutputPacketLength(void);
+
 #define ATARIJOY_BITMASK_UP    0x01
 #define ATARIJOY_BITMASK_DOWN  0x02
 #define ATARIJOY_BITMASK_LEFT  0x04
@@ -142,6 +164,12 @@ extern void IKBD_SendAutoKeyboardCommands(void);
  */
 
 extern uint8_t Joy_GetStickData(int nStJoyId);
+
+/* Send the current 'MouseConfig' to the PS/2 mouse */
+extern void Mouse_ApplyConfig(void);
+
+/* Send the current 'KeyboardLeds' to the PS/2 keyboard */
+extern void Keyboard_ApplyLeds(void);
 #ifdef __cplusplus
 }
 #endif
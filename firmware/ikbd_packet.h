@@ -0,0 +1,31 @@
+// ikbd_packet.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#ifndef IKBD_PACKET_H
+#define IKBD_PACKET_H
+
+#include <stdint.h>
+
+// Length of an IKBD output packet from its header byte, shared by the
+// firmware's output (IKBD_OutputPacketLength) and the simulation tools.
+// Other bytes are single byte key codes. Joystick monitoring (0x17) sends
+// headerless 2 byte packets, which the caller has to know about.
+static inline uint8_t ikbd_packet_length(const uint8_t header)
+{
+    if (header >= 0x7c && header <= 0x7f)
+        return 5;           // high resolution relative mouse (0x3C)
+    switch (header) {
+    case 0xf6: return 8;    // status, memory and vendor reports
+    case 0xf7: return 6;    // absolute mouse position
+    case 0xf8: case 0xf9: case 0xfa: case 0xfb:
+        return 3;           // relative mouse
+    case 0xfc: return 7;    // time of day
+    case 0xfd: return 3;    // both joysticks
+    case 0xfe: case 0xff:
+        return 2;           // joystick event
+    default: return 1;
+    }
+}
+
+#endif // IKBD_PACKET_H
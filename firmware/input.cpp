@@ -0,0 +1,109 @@
+// input.cpp
+// Copyright (c) 2025 Rob Gowin
+// Copyright (c) 2023-2024 Daniel Cliche
+// SPDX-License-Identifier: MIT
+
+#include "input.h"
+
+#include "capture.h"
+#include "config.h"
+#include "hal.h"
+#include "ikbd.h"
+#include "keymap.h"
+#include "ps2_keyboard.h"
+#include "remap.h"
+#include "settings.h"
+
+#define Y_OVERFLOW (1 << 7)
+#define X_OVERFLOW (1 << 6)
+#define Y_SIGN (1 << 5)
+#define X_SIGN (1 << 4)
+#define ALWAYS_ONE (1 << 3)
+#define MIDDLE_BUTTON (1 << 2)
+#define RIGHT_BUTTON (1 << 1)
+#define LEFT_BUTTON (1 << 0)
+
+// The three bytes of a movement packet arrive within a few ms of each other.
+#define MOUSE_PACKET_TIMEOUT_MS 20
+
+// Scan code decoding state.
+static bool brk = false, extended = false;
+static uint8_t skip = 0;
+
+void input_keyboard_lost(void)
+{
+    brk = false;
+    extended = false;
+    skip = 0;
+    remap_release_all();
+}
+
+void input_keyboard_byte(const uint8_t code)
+{
+    CAPTURE(CAPTURE_KEYBOARD, code);
+    if (skip) {
+        skip--;
+        return;
+    }
+    if (code == 0xF0) brk = true;
+    else if (code == 0xE0) extended = true;
+    else if (code == 0xE1) {
+        // Pause/Break: E1 14 77 E1 F0 14 F0 77. Eat the next seven bytes,
+        // this key press/release is completely ignored.
+        skip = 7;
+    } else if (code == 0xAA) {
+        // Self-test passed, after our reset or when a keyboard is plugged in:
+        // the releases of keys held when it was unplugged never came.
+        input_keyboard_lost();
+        if (settings_boot_flags() & SETTINGS_SLOW_TYPEMATIC) PS2Keyboard::set_typematic(0x7F);
+        if (settings_boot_flags() & SETTINGS_SET3) PS2Keyboard::select_scan_code_set_3();
+    } else if (code == 0x00 || code == 0xFF) {
+        // The keyboard's own buffer overran.
+        input_keyboard_lost();
+    } else {
+        const uint8_t key =
+            keymap_translate(code, extended, PS2Keyboard::scan_code_set() == 3, Settings.keyboard_layout);
+        const uint8_t st_scan_code = remap_key(key, !brk);
+        bool pressed = false;
+        if (st_scan_code != 0 && st_scan_code < KEY_PS2_ONLY) pressed = IKBD_PressSTKey(st_scan_code, !brk);
+        // Only for the press the host gets, not for its typematic repeats.
+        if (st_scan_code == 0x3A && pressed && !KeyboardLeds.HostControl) { // caps lock
+            KeyboardLeds.Leds ^= PS2_LED_CAPS_LOCK;
+            Keyboard_ApplyLeds();
+        }
+        brk = false;
+        extended = false;
+    }
+}
+
+bool input_mouse_byte(const uint8_t c)
+{
+    static uint8_t packet[3];
+    static uint8_t packet_len = 0;
+    static uint32_t packet_ms = 0;
+
+    CAPTURE(CAPTURE_MOUSE, c);
+    // Drop a partial packet left behind by a lost byte or a command exchange.
+    const uint32_t now = hal_millis();
+    if (packet_len && now - packet_ms > MOUSE_PACKET_TIMEOUT_MS) packet_len = 0;
+    // Bit 3 of the first byte is always set; skip bytes until back in sync.
+    if (packet_len == 0) {
+        if (!(c & ALWAYS_ONE)) return false;
+        packet_ms = now;
+    }
+    packet[packet_len++] = c;
+    if (packet_len < 3) return false;
+    packet_len = 0;
+
+    const uint8_t mstat = packet[0];
+    int dx = packet[1], dy = packet[2];
+    if (mstat & X_SIGN) dx -= 256; /* sign extend */
+    if (mstat & Y_SIGN) dy -= 256;
+    KeyboardProcessor.Mouse.dx += dx;
+    KeyboardProcessor.Mouse.dy += dy;
+
+    IKBD_SetMouseButtons(mstat & LEFT_BUTTON, mstat & RIGHT_BUTTON);
+
+    /* FIXME: Deal with mouse overflow bits. */
+    return true;
+}
@@ -0,0 +1,29 @@
+// input.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Turns the bytes read from the PS/2 keyboard and mouse into IKBD key
+// presses, mouse motion and buttons. Kept apart from the drivers so that
+// the host build can be fed the same bytes.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void input_keyboard_byte(uint8_t code);
+// Key events were lost: start decoding afresh and release the keys down.
+void input_keyboard_lost(void);
+// Return true when the byte completes a movement packet.
+bool input_mouse_byte(uint8_t c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // INPUT_H
@@ -0,0 +1,38 @@
+/* Derived from: */
+/*
+  Hatari - joy.c
+
+  This file is distributed under the GNU General Public License, version 2
+  or at your option any later version. Read the file gpl.txt for details.
+
+  AVR port Copyright (c) 2025 Rob Gowin
+  SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#include <stdint.h>
+#include "capture.h"
+#include "hal.h"
+#include "ikbd.h"
+#include "joy.h"
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Read the DE9 joystick port and return ST format byte, i.e. lower 4 bits
+ * direction and top bit fire.
+ */
+uint8_t Joy_GetStickData(const int nStJoyId)
+{
+    // FIXME: Deal with joystick emulation and autofire. See full function in Hatari src/joy.c.
+    uint8_t result = 0;
+    // Get the value of the GPIO port
+    const uint8_t gpio_value = hal_joystick_read(nStJoyId == 0 ? 0 : 1);
+    CAPTURE_JOYSTICK(nStJoyId, gpio_value);
+
+    // Arrange the bits in the order expected by the IKBD protocol.
+    if (!(gpio_value & GPIO_MASK_UP))    result |= ATARIJOY_BITMASK_UP;
+    if (!(gpio_value & GPIO_MASK_DOWN))  result |= ATARIJOY_BITMASK_DOWN;
+    if (!(gpio_value & GPIO_MASK_LEFT))  result |= ATARIJOY_BITMASK_LEFT;
+    if (!(gpio_value & GPIO_MASK_RIGHT)) result |= ATARIJOY_BITMASK_RIGHT;
+    if (!(gpio_value & GPIO_MASK_FIRE))  result |= ATARIJOY_BITMASK_FIRE;
+
+    return result;
+}
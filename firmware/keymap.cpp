@@ -0,0 +1,173 @@
+// keymap.cpp
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#include "keymap.h"
+
+// The tables below are computed from keys.h by the compiler: each entry
+// is a constexpr search of the key list, so adding a key or a layout
+// means editing a list rather than hex tables.
+
+namespace {
+
+struct Key {
+    uint8_t st;
+    uint16_t set2;
+    uint8_t set3;
+};
+
+constexpr Key keys[] = {
+#define KEY(name, st, set2, set3) { st, set2, set3 },
+#include "keys.h"
+#undef KEY
+};
+
+constexpr unsigned NUM_KEYS = sizeof(keys) / sizeof(keys[0]);
+
+constexpr bool is_extended(const unsigned i)
+{
+    return keys[i].set2 > 0xFF;
+}
+
+constexpr uint8_t st_of_set2(const uint16_t code, const unsigned i = 0)
+{
+    return i == NUM_KEYS ? 0 : keys[i].set2 == code ? keys[i].st : st_of_set2(code, i + 1);
+}
+
+constexpr uint8_t st_of_set3(const uint8_t code, const unsigned i = 0)
+{
+    return i == NUM_KEYS ? 0 : keys[i].set3 == code ? keys[i].st : st_of_set3(code, i + 1);
+}
+
+constexpr unsigned max_set2(const unsigned i = 0, const unsigned max = 0)
+{
+    return i == NUM_KEYS ? max : max_set2(i + 1, !is_extended(i) && keys[i].set2 > max ? keys[i].set2 : max);
+}
+
+constexpr unsigned max_set3(const unsigned i = 0, const unsigned max = 0)
+{
+    return i == NUM_KEYS ? max : max_set3(i + 1, keys[i].set3 > max ? keys[i].set3 : max);
+}
+
+// 0, 1, ..., N - 1 as a parameter pack.
+template <unsigned... I> struct Indices {};
+template <unsigned N, unsigned... I> struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+template <unsigned... I> struct MakeIndices<0, I...> {
+    typedef Indices<I...> Type;
+};
+
+template <unsigned N> struct Table {
+    uint8_t st[N];
+};
+
+template <unsigned... I> constexpr Table<sizeof...(I)> set2_table(Indices<I...>)
+{
+    return { { st_of_set2(I)... } };
+}
+
+template <unsigned... I> constexpr Table<sizeof...(I)> set3_table(Indices<I...>)
+{
+    return { { st_of_set3(I)... } };
+}
+
+// Set 2 and set 3 make codes are small and dense enough to index with.
+constexpr unsigned SET2_SIZE = max_set2() + 1;
+constexpr unsigned SET3_SIZE = max_set3() + 1;
+
+const Table<SET2_SIZE> set2_map PROGMEM = set2_table(MakeIndices<SET2_SIZE>::Type());
+const Table<SET3_SIZE> set3_map PROGMEM = set3_table(MakeIndices<SET3_SIZE>::Type());
+
+// The extended set 2 codes are few and spread out, so they go in a
+// perfect hash instead: slot (code * EXT_MULTIPLIER mod 256) / 8, with the
+// multiplier searched for at compile time.
+constexpr unsigned EXT_SLOTS = 32;
+
+constexpr uint8_t ext_slot(const uint8_t code, const uint8_t multiplier)
+{
+    return (uint8_t)(code * multiplier) >> 3;
+}
+
+// Whether the extended keys from i on land in different slots, none of
+// them in the used ones.
+constexpr bool no_clash(const uint8_t multiplier, const unsigned i = 0, const uint32_t used = 0)
+{
+    return i == NUM_KEYS ? true
+         : !is_extended(i) ? no_clash(multiplier, i + 1, used)
+         : used >> ext_slot(keys[i].set2, multiplier) & 1 ? false
+         : no_clash(multiplier, i + 1, used | 1UL << ext_slot(keys[i].set2, multiplier));
+}
+
+constexpr uint8_t find_multiplier(const unsigned multiplier = 1)
+{
+    return multiplier > 0xFF ? 0 : no_clash(multiplier) ? multiplier : find_multiplier(multiplier + 2);
+}
+
+constexpr uint8_t EXT_MULTIPLIER = find_multiplier();
+static_assert(EXT_MULTIPLIER != 0, "extended keys don't hash without clashes, raise EXT_SLOTS");
+
+// Extended key in a slot, NUM_KEYS if none.
+constexpr unsigned ext_key(const unsigned slot, const unsigned i = 0)
+{
+    return i == NUM_KEYS ? NUM_KEYS
+         : is_extended(i) && ext_slot(keys[i].set2, EXT_MULTIPLIER) == slot ? i : ext_key(slot, i + 1);
+}
+
+struct ExtTable {
+    uint8_t code[EXT_SLOTS];
+    uint8_t st[EXT_SLOTS];
+};
+
+template <unsigned... I> constexpr ExtTable ext_table(Indices<I...>)
+{
+    return { { (ext_key(I) == NUM_KEYS ? (uint8_t)0 : (uint8_t)keys[ext_key(I)].set2)... },
+             { (ext_key(I) == NUM_KEYS ? (uint8_t)0 : keys[ext_key(I)].st)... } };
+}
+
+const ExtTable ext_map PROGMEM = ext_table(MakeIndices<EXT_SLOTS>::Type());
+
+// Pairs of ST scan codes swapped by each layout, 0 padded: letters and
+// the UK \ key only, see keymap.h.
+#define MAX_SWAPS 3
+const uint8_t layout_swaps[KEYMAP_LAYOUT_COUNT][2 * MAX_SWAPS] PROGMEM = {
+    { 0 },                                      // US
+    { 0x2B, 0x60 },                             // UK: \| sits left of Z
+    { 0x15, 0x2C },                             // DE: QWERTZ
+    { 0x10, 0x1E, 0x11, 0x2C, 0x27, 0x32 },     // FR: AZERTY, M right of L
+};
+
+} // namespace
+
+uint8_t keymap_translate(const uint8_t code, const bool extended, const bool set3, const uint8_t layout)
+{
+    uint8_t st = 0;
+    if (set3) {
+        if (code < SET3_SIZE) st = pgm_read_byte(&set3_map.st[code]);
+    } else if (extended) {
+        const uint8_t slot = ext_slot(code, EXT_MULTIPLIER);
+        if (pgm_read_byte(&ext_map.code[slot]) == code) st = pgm_read_byte(&ext_map.st[slot]);
+    } else {
+        if (code < SET2_SIZE) st = pgm_read_byte(&set2_map.st[code]);
+    }
+    if (st == 0 || layout >= KEYMAP_LAYOUT_COUNT) return st;
+    for (uint8_t i = 0; i < 2 * MAX_SWAPS; i += 2) {
+        const uint8_t a = pgm_read_byte(&layout_swaps[layout][i]);
+        const uint8_t b = pgm_read_byte(&layout_swaps[layout][i + 1]);
+        if (a == 0) break;
+        if (st == a) return b;
+        if (st == b) return a;
+    }
+    return st;
+}
+
+#if DEBUG
+PGM_P keymap_key_name(const uint8_t code, const bool extended)
+{
+    switch (extended ? 0xE000 | code : code) {
+#define KEY(name, st, set2, set3) \
+    case set2: return PSTR(name);
+#include "keys.h"
+#undef KEY
+    }
+    return PSTR("");
+}
+#endif
@@ -0,0 +1,52 @@
+// keymap.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#ifndef KEYMAP_H
+#define KEYMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "hal.h"
+
+// PS/2 to Atari ST scan code translation, built at compile time from the
+// key list in keys.h.
+
+// Key codes from here up stand for PS/2 keys the ST doesn't have. They
+// aren't sent, but can be remapped (remap.h).
+#define KEY_PS2_ONLY 0x74
+
+// Layouts let the letter keys of a keyboard with US legends type what
+// they say on an ST running national TOS, by swapping the few letters that
+// sit elsewhere on the national keyboards (and UK's \ key). Only letters
+// are moved: digits and punctuation map by position and type what the
+// national ST keyboard has there, such as the unshifted AZERTY symbols on
+// the digit row with French TOS, and ; typing , where the M went.
+enum {
+    KEYMAP_LAYOUT_US,
+    KEYMAP_LAYOUT_UK,
+    KEYMAP_LAYOUT_DE,
+    KEYMAP_LAYOUT_FR,
+    KEYMAP_LAYOUT_COUNT
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Key code of a make code, extended for set 2 codes after 0xE0: an ST
+// scan code, a KEY_PS2_ONLY code, or 0 for codes we don't know.
+uint8_t keymap_translate(uint8_t code, bool extended, bool set3, uint8_t layout);
+
+#if DEBUG
+// Name of a set 2 key, in flash.
+PGM_P keymap_key_name(uint8_t code, bool extended);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // KEYMAP_H
@@ -0,0 +1,113 @@
+// keys.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// The keys we know: KEY(name, st, set2, set3), where st is the Atari ST
+// scan code (from KEY_PS2_ONLY up for keys the ST doesn't have), set2 the
+// PS/2 scan code set 2 make code (0xE0xx for the extended ones) and set3
+// the scan code set 3 make code. keymap.cpp builds its translation tables
+// from this list at compile time.
+
+KEY("Escape", 0x01, 0x76, 0x08)
+KEY("1", 0x02, 0x16, 0x16)
+KEY("2", 0x03, 0x1e, 0x1e)
+KEY("3", 0x04, 0x26, 0x26)
+KEY("4", 0x05, 0x25, 0x25)
+KEY("5", 0x06, 0x2e, 0x2e)
+KEY("6", 0x07, 0x36, 0x36)
+KEY("7", 0x08, 0x3d, 0x3d)
+KEY("8", 0x09, 0x3e, 0x3e)
+KEY("9", 0x0a, 0x46, 0x46)
+KEY("0", 0x0b, 0x45, 0x45)
+KEY("Minus (-_)", 0x0c, 0x4e, 0x4e)
+KEY("Equals (=+)", 0x0d, 0x55, 0x55)
+KEY("Backspace", 0x0e, 0x66, 0x66)
+KEY("Tab", 0x0f, 0x0d, 0x0d)
+KEY("Q", 0x10, 0x15, 0x15)
+KEY("W", 0x11, 0x1d, 0x1d)
+KEY("E", 0x12, 0x24, 0x24)
+KEY("R", 0x13, 0x2d, 0x2d)
+KEY("T", 0x14, 0x2c, 0x2c)
+KEY("Y", 0x15, 0x35, 0x35)
+KEY("U", 0x16, 0x3c, 0x3c)
+KEY("I", 0x17, 0x43, 0x43)
+KEY("O", 0x18, 0x44, 0x44)
+KEY("P", 0x19, 0x4d, 0x4d)
+KEY("Left Bracket ([{)", 0x1a, 0x54, 0x54)
+KEY("Right Bracket (]})", 0x1b, 0x5b, 0x5b)
+KEY("Enter", 0x1c, 0x5a, 0x5a)
+KEY("Left Ctrl", 0x1d, 0x14, 0x11)
+KEY("Right Ctrl", 0x1d, 0xe014, 0x58)
+KEY("A", 0x1e, 0x1c, 0x1c)
+KEY("S", 0x1f, 0x1b, 0x1b)
+KEY("D", 0x20, 0x23, 0x23)
+KEY("F", 0x21, 0x2b, 0x2b)
+KEY("G", 0x22, 0x34, 0x34)
+KEY("H", 0x23, 0x33, 0x33)
+KEY("J", 0x24, 0x3b, 0x3b)
+KEY("K", 0x25, 0x42, 0x42)
+KEY("L", 0x26, 0x4b, 0x4b)
+KEY("Semicolon (;:)", 0x27, 0x4c, 0x4c)
+KEY("Apostrophe ('\")", 0x28, 0x52, 0x52)
+KEY("Backtick/Tilde (`~)", 0x29, 0x0e, 0x0e)
+KEY("Left Shift", 0x2a, 0x12, 0x12)
+KEY("Backslash (\\|)", 0x2b, 0x5d, 0x5c)
+KEY("Z", 0x2c, 0x1a, 0x1a)
+KEY("X", 0x2d, 0x22, 0x22)
+KEY("C", 0x2e, 0x21, 0x21)
+KEY("V", 0x2f, 0x2a, 0x2a)
+KEY("B", 0x30, 0x32, 0x32)
+KEY("N", 0x31, 0x31, 0x31)
+KEY("M", 0x32, 0x3a, 0x3a)
+KEY("Comma (,<)", 0x33, 0x41, 0x41)
+KEY("Period (.>)", 0x34, 0x49, 0x49)
+KEY("Slash (/?)", 0x35, 0x4a, 0x4a)
+KEY("Right Shift", 0x36, 0x59, 0x59)
+KEY("Left Alt", 0x38, 0x11, 0x19)
+KEY("Right Alt", 0x38, 0xe011, 0x39)
+KEY("Space", 0x39, 0x29, 0x29)
+KEY("CapsLock", 0x3a, 0x58, 0x14)
+KEY("F1", 0x3b, 0x05, 0x07)
+KEY("F2", 0x3c, 0x06, 0x0f)
+KEY("F3", 0x3d, 0x04, 0x17)
+KEY("F4", 0x3e, 0x0c, 0x1f)
+KEY("F5", 0x3f, 0x03, 0x27)
+KEY("F6", 0x40, 0x0b, 0x2f)
+KEY("F7", 0x41, 0x83, 0x37)
+KEY("F8", 0x42, 0x0a, 0x3f)
+KEY("F9", 0x43, 0x01, 0x47)
+KEY("F10", 0x44, 0x09, 0x4f)
+KEY("Home", 0x47, 0xe06c, 0x6e)
+KEY("Up Arrow", 0x48, 0xe075, 0x63)
+KEY("Page Up", 0x49, 0xe07d, 0x6f)
+KEY("Keypad -", 0x4a, 0x7b, 0x84)
+KEY("Left Arrow", 0x4b, 0xe06b, 0x61)
+KEY("Right Arrow", 0x4d, 0xe074, 0x6a)
+KEY("Keypad +", 0x4e, 0x79, 0x7c)
+KEY("End", 0x4f, 0xe069, 0x65)
+KEY("Down Arrow", 0x50, 0xe072, 0x60)
+KEY("Page Down", 0x51, 0xe07a, 0x6d)
+KEY("Insert", 0x52, 0xe070, 0x67)
+KEY("Delete", 0x53, 0xe071, 0x64)
+KEY("UK \\| between left shift and Z", 0x60, 0x61, 0x13)
+KEY("F12", 0x61, 0x07, 0x5e)
+KEY("F11", 0x62, 0x78, 0x56)
+KEY("Keypad /", 0x65, 0xe04a, 0x77)
+KEY("Keypad *", 0x66, 0x7c, 0x7e)
+KEY("Keypad 7/Home", 0x67, 0x6c, 0x6c)
+KEY("Keypad 8/Up", 0x68, 0x75, 0x75)
+KEY("Keypad 9/PgUp", 0x69, 0x7d, 0x7d)
+KEY("Keypad 4/Left", 0x6a, 0x6b, 0x6b)
+KEY("Keypad 5", 0x6b, 0x73, 0x73)
+KEY("Keypad 6/Right", 0x6c, 0x74, 0x74)
+KEY("Keypad 1/End", 0x6d, 0x69, 0x69)
+KEY("Keypad 2/Down", 0x6e, 0x72, 0x72)
+KEY("Keypad 3/PgDn", 0x6f, 0x7a, 0x7a)
+KEY("Keypad 0/Ins", 0x70, 0x70, 0x70)
+KEY("Keypad ./Del", 0x71, 0x71, 0x71)
+KEY("Keypad Enter", 0x72, 0xe05a, 0x79)
+KEY("NumLock", 0x74, 0x77, 0x76)
+KEY("ScrollLock", 0x75, 0x7e, 0x5f)
+KEY("Left GUI (Windows)", 0x76, 0xe01f, 0x8b)
+KEY("Right GUI (Windows)", 0x77, 0xe027, 0x8c)
+KEY("Menu", 0x78, 0xe02f, 0x8d)
@@ -0,0 +1,41 @@
+// perf.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+
+// Health counters, bumped by the hot paths and read back by the host with
+// the vendor IKBD command 0xB2 (cleared with 0x32). Counters wrap around.
+// Some are updated by the PS/2 interrupt handlers, so read them with
+// interrupts masked.
+
+enum {
+    PERF_KEYBOARD,
+    PERF_MOUSE,
+};
+
+typedef struct {
+    uint16_t ps2_overflows[2];      // bytes lost to a full PS/2 receive ring
+    uint16_t ps2_parity_errors[2];
+    uint16_t ps2_framing_errors[2]; // stop bit low
+    uint8_t ps2_ring_high[2];       // most bytes seen waiting in a receive ring
+    uint16_t packets_dropped;       // IKBD packets dropped, output buffer full
+    uint16_t output_high;           // most bytes waiting in the IKBD output buffer
+    uint32_t bytes_received;        // from the host
+    uint32_t bytes_sent;            // to the host
+} PERF_COUNTERS;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern volatile PERF_COUNTERS PerfCounters;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PERF_H
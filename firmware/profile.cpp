@@ -0,0 +1,92 @@
+// profile.cpp
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#include "profile.h"
+
+#if PROFILE_BUILD
+
+#include <Arduino.h>
+#include <string.h>
+
+static volatile uint8_t g_overflows;
+static uint16_t g_buckets[PROFILE_COUNT][PROFILE_BUCKETS];
+static uint16_t g_max[PROFILE_COUNT];
+
+ISR(TIMER2_OVF_vect)
+{
+    g_overflows++;
+}
+
+void profile_init(void)
+{
+    // Normal mode, F_CPU/32, overflow interrupt to extend the count to 16 bits.
+    TCCR2A = 0;
+    TCCR2B = (1 << CS21) | (1 << CS20);
+    TCNT2 = 0;
+    TIMSK2 = (1 << TOIE2);
+}
+
+uint16_t profile_now(void)
+{
+    const uint8_t state = SREG;
+    cli();
+    const uint8_t low = TCNT2;
+    uint8_t high = g_overflows;
+    // An overflow not serviced yet, as in micros().
+    if ((TIFR2 & (1 << TOV2)) && low < 255)
+        high++;
+    SREG = state;
+    return (uint16_t)high << 8 | low;
+}
+
+static void record(const uint8_t id, uint16_t ticks)
+{
+    if (ticks > g_max[id])
+        g_max[id] = ticks;
+    uint8_t b = 0;
+    while (ticks && b < PROFILE_BUCKETS - 1) {
+        ticks >>= 1;
+        b++;
+    }
+    if (g_buckets[id][b] != 0xffff)
+        g_buckets[id][b]++;
+}
+
+void profile_stage(const uint8_t id, uint16_t *since)
+{
+    const uint16_t now = profile_now();
+    // No need to mask interrupts: handlers only update their own histograms.
+    record(id, now - *since);
+    *since = now;
+}
+
+uint8_t profile_isr_enter(void)
+{
+    return TCNT2;
+}
+
+void profile_isr_exit(const uint8_t id, const uint8_t entered)
+{
+    record(id, (uint8_t)(TCNT2 - entered));
+}
+
+void profile_read(const uint8_t id, uint16_t buckets[PROFILE_BUCKETS], uint16_t *max)
+{
+    const uint8_t state = SREG;
+    cli();
+    memcpy(buckets, g_buckets[id], sizeof(g_buckets[id]));
+    *max = g_max[id];
+    SREG = state;
+}
+
+void profile_clear(void)
+{
+    const uint8_t state = SREG;
+    cli();
+    memset(g_buckets, 0, sizeof(g_buckets));
+    memset(g_max, 0, sizeof(g_max));
+    SREG = state;
+}
+
+#endif // PROFILE_BUILD
@@ -0,0 +1,82 @@
+// profile.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+// Optional profiler (PROFILE_ENA): time spent in each stage of loop(), in
+// a whole loop iteration and in the interrupt handlers, kept as log2
+// histograms in RAM and read back with the vendor IKBD command 0xB3.
+// Times come from Timer2, running free at F_CPU/32 (4.34 us per tick).
+// Without PROFILE_ENA, or on the host, the macros below compile to nothing.
+
+#if PROFILE_ENA && !defined(KEMOJO_HOST)
+#define PROFILE_BUILD 1
+#else
+#define PROFILE_BUILD 0
+#endif
+
+enum {
+    PROFILE_COMMAND,        // host command byte
+    PROFILE_MOUSE,          // poll_mouse()
+    PROFILE_KEYBOARD,       // poll_keyboard()
+    PROFILE_CONFIG,         // rate control and mouse configuration
+    PROFILE_REPORT,         // automatic reports
+    PROFILE_OUTPUT,         // output drain
+    PROFILE_LOOP,           // whole loop() iteration
+    PROFILE_ISR_KEYBOARD,   // PS/2 keyboard clock interrupt
+    PROFILE_ISR_MOUSE,      // PS/2 mouse clock interrupt
+    PROFILE_ISR_RESET_TIMER,
+    PROFILE_COUNT
+};
+
+// Bucket 0 counts times of 0 ticks, bucket n times of 2^(n-1) to 2^n - 1
+// ticks, and the last one everything longer.
+#define PROFILE_BUCKETS 12
+#define PROFILE_TICK_NS 4340
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if PROFILE_BUILD
+
+void profile_init(void);
+// Main loop time stamp.
+uint16_t profile_now(void);
+// Record the time since *since in histogram 'id' and restart from now.
+void profile_stage(uint8_t id, uint16_t *since);
+// Interrupt handler entry and exit, for handlers shorter than 1 ms.
+uint8_t profile_isr_enter(void);
+void profile_isr_exit(uint8_t id, uint8_t entered);
+
+// Copy of histogram 'id' and its longest time, in ticks.
+void profile_read(uint8_t id, uint16_t buckets[PROFILE_BUCKETS], uint16_t *max);
+void profile_clear(void);
+
+#define PROFILE_INIT() profile_init()
+#define PROFILE_START(t) uint16_t t = profile_now()
+#define PROFILE_STAGE(id, t) profile_stage(id, &t)
+#define PROFILE_ISR_ENTER(t) const uint8_t t = profile_isr_enter()
+#define PROFILE_ISR_EXIT(id, t) profile_isr_exit(id, t)
+
+#else
+
+#define PROFILE_INIT()
+#define PROFILE_START(t)
+#define PROFILE_STAGE(id, t)
+#define PROFILE_ISR_ENTER(t)
+#define PROFILE_ISR_EXIT(id, t)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROFILE_H
@@ -183,3 +183,139 @@ int ps2_write_byte_with_timeout(const int clk_pin, const int data_pin, uint8_t d
     ps2_pull_low(clk_pin);                       // put a hold on the incoming data
     return 0; // Did not timeout.
 }
+
+// The device must start clocking within 15 ms of a request to send and
+// answer within 20 ms of the end of the transfer; allow a little more.
+#define PS2_TX_TIMEOUT_MS 25
+#define PS2_TX_MAX_RETRIES 3
+
+void ps2_tx_init(ps2_tx_t *tx, const int clk_pin, const int data_pin)
+{
+    tx->clk_pin = clk_pin;
+    tx->data_pin = data_pin;
+    tx->head = tx->tail = 0;
+    tx->bitcount = 0;
+    tx->awaiting_ack = false;
+    tx->retries = 0;
+    tx->errors = 0;
+    tx->timeouts = 0;
+    tx->answer_due = false;
+}
+
+bool ps2_tx_queue(ps2_tx_t *tx, const uint8_t data)
+{
+    const uint8_t i = (tx->tail + 1) & PS2_TX_QUEUE_MASK;
+    if (i == tx->head)
+        return false;
+    tx->queue[tx->tail] = data;
+    tx->tail = i;
+    return true;
+}
+
+bool ps2_tx_idle(const ps2_tx_t *tx)
+{
+    return tx->head == tx->tail;
+}
+
+bool ps2_tx_clock(ps2_tx_t *tx, const uint8_t ring_head)
+{
+    const uint8_t n = tx->bitcount;
+    if (n == 0)
+        return false;
+    if (n == PS2_TX_INHIBIT)
+        return true; // our own falling edge while requesting to send
+    if (n <= 8) {
+        // The device samples data on the rising edge, so change it while the clock is low.
+        const uint8_t bit = (tx->data >> (n - 1)) & 0x01;
+        if (bit)
+            ps2_pull_high(tx->data_pin);
+        else
+            ps2_pull_low(tx->data_pin);
+        tx->parity ^= bit;
+    } else if (n == 9) {
+        if (tx->parity)
+            ps2_pull_high(tx->data_pin);
+        else
+            ps2_pull_low(tx->data_pin);
+    } else if (n == 10) {
+        ps2_pull_high(tx->data_pin); // stop bit
+    } else {
+        // The device pulls data low on the 11th clock to acknowledge the transfer.
+        tx->answer_pos = ring_head;
+        tx->bitcount = 0;
+        return true;
+    }
+    tx->bitcount = n + 1;
+    return true;
+}
+
+static void ps2_tx_start(ps2_tx_t *tx)
+{
+    tx->bitcount = PS2_TX_INHIBIT;
+    ps2_pull_low(tx->clk_pin); // inhibit communication for at least 100 us
+    delayMicroseconds(100);
+    tx->data = tx->queue[tx->head];
+    tx->parity = 1;
+    tx->answer_due = false;
+    tx->bitcount = 1;
+    ps2_pull_low(tx->data_pin); // request to send (start bit)
+    ps2_pull_high(tx->clk_pin); // the device now generates the clock
+    tx->awaiting_ack = true;
+    tx->start_ms = millis();
+}
+
+static void ps2_tx_next(ps2_tx_t *tx)
+{
+    tx->head = (tx->head + 1) & PS2_TX_QUEUE_MASK;
+    tx->awaiting_ack = false;
+    tx->retries = 0;
+}
+
+static void ps2_tx_fail(ps2_tx_t *tx)
+{
+    tx->head = tx->tail;
+    tx->awaiting_ack = false;
+    tx->retries = 0;
+    tx->errors++;
+}
+
+bool ps2_tx_receive(ps2_tx_t *tx, const uint8_t c, const uint8_t ring_pos)
+{
+    if (!tx->awaiting_ack || tx->bitcount != 0)
+        return false;
+    // The answer comes after whatever was in the ring when the transfer ended.
+    if (!tx->answer_due) {
+        if (ring_pos != tx->answer_pos)
+            return false;
+        tx->answer_due = true;
+    }
+    if (c == 0xFE && tx->retries < PS2_TX_MAX_RETRIES) {
+        // Resend request: transmit the same byte again.
+        tx->retries++;
+        tx->awaiting_ack = false;
+    } else if (c == 0xFA || (c == 0xEE && tx->data == 0xEE)) {
+        ps2_tx_next(tx);
+    } else if (c == 0xFC || c == 0xFE) {
+        // Error or too many resends.
+        ps2_tx_fail(tx);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void ps2_tx_service(ps2_tx_t *tx)
+{
+    if (tx->awaiting_ack) {
+        if (millis() - tx->start_ms <= PS2_TX_TIMEOUT_MS)
+            return;
+        // No clock or no answer from the device.
+        tx->bitcount = 0;
+        ps2_pull_high(tx->clk_pin);
+        ps2_pull_high(tx->data_pin);
+        ps2_tx_fail(tx);
+        tx->timeouts++;
+    }
+    if (!ps2_tx_idle(tx))
+        ps2_tx_start(tx);
+}
@@ -15,4 +15,49 @@ void ps2_write_byte(int clk_pin, int data_pin, uint8_t data);
 // Return 1 of write timed out, or 0 if it did not.
 int ps2_write_byte_with_timeout(int clk_pin, int data_pin, uint8_t data, unsigned long timeout);
 
+// Interrupt-driven host-to-device transmission.
+// Bytes are queued from the main loop and clocked out by the port's clock
+// interrupt, one at a time: the next byte is only sent once the device has
+// acknowledged the previous one with 0xFA, or answered the echo command
+// 0xEE with 0xEE. A 0xFE reply causes a resend.
+// If a byte fails (0xFC, too many resends or no answer), the rest of the
+// queue is dropped too, so that command arguments are never sent on their
+// own; callers can watch 'errors' to retry.
+#define PS2_TX_QUEUE_SIZE 16
+#define PS2_TX_QUEUE_MASK (PS2_TX_QUEUE_SIZE - 1)
+#define PS2_TX_INHIBIT 0xFF
+
+typedef struct {
+    uint8_t clk_pin, data_pin;
+    uint8_t queue[PS2_TX_QUEUE_SIZE];
+    uint8_t head, tail;
+    volatile uint8_t bitcount;  // 0 when idle, PS2_TX_INHIBIT while holding the clock low
+    volatile uint8_t data;
+    volatile uint8_t parity;
+    bool awaiting_ack;
+    uint8_t retries;
+    uint8_t errors;             // incremented each time a byte is given up on
+    uint8_t timeouts;           // the same, for the device not answering at all
+    volatile uint8_t answer_pos; // receive ring head when the transfer ended
+    bool answer_due;             // the bytes received before then have been read
+    unsigned long start_ms;
+} ps2_tx_t;
+
+void ps2_tx_init(ps2_tx_t *tx, int clk_pin, int data_pin);
+// Return false if the queue is full.
+bool ps2_tx_queue(ps2_tx_t *tx, uint8_t data);
+// Return true if nothing is queued or in flight.
+bool ps2_tx_idle(const ps2_tx_t *tx);
+// Call from the clock interrupt with the head of the receive ring. Return
+// true if the edge belonged to a host-to-device transfer, in which case it
+// must not be decoded as data.
+bool ps2_tx_clock(ps2_tx_t *tx, uint8_t ring_head);
+// Call with each received byte and the ring position it was read after.
+// Return true if the byte was the device's response to a queued byte and
+// has been consumed. Bytes received before the end of the transfer, such
+// as movement packets, are never taken as the response.
+bool ps2_tx_receive(ps2_tx_t *tx, uint8_t c, uint8_t ring_pos);
+// Call from the main loop: start the next queued byte and handle timeouts.
+void ps2_tx_service(ps2_tx_t *tx);
+
 #endif // PS2_H
@@ -12,6 +12,9 @@
 #include <Arduino.h>
 
 #include "config.h"
+#include "perf.h"
+#include "profile.h"
+#include "settings.h"
 
 #define BUFFER_SIZE 128
 
@@ -19,26 +22,70 @@ static volatile uint8_t g_buffer[BUFFER_SIZE];
 static volatile uint8_t g_head, g_tail;
 static volatile bool g_buffer_overflow;
 static uint8_t g_clk_pin, g_data_pin;
+static ps2_tx_t g_tx;
+static bool g_present;
+static uint8_t g_scan_code_set = 2;
+static unsigned long g_probe_ms;
+static uint8_t g_leds_wanted, g_leds_current, g_leds_sent;
+static uint8_t g_typematic;
+
+// Commands that must get through. A failed byte drops the whole transmit
+// queue (ps2.h), so whatever was queued with it is queued again.
+#define CMD_TYPEMATIC 0x01
+#define CMD_SET_2 0x02
+#define CMD_MAKE_BREAK 0x04     // set 3: all keys make/break
+#define CMD_LEDS 0x08
+#define CMD_ECHO 0x10           // see ping()
+static uint8_t g_cmds_wanted, g_cmds_queued;
+static uint8_t g_cmds_errors;
+static uint8_t g_timeouts;
+
+// Scan code set 3 probe: select set 3, then ask which set is in use. It is
+// sent on its own, and nothing else until the keyboard has answered.
+enum { PROBE_NONE, PROBE_WANTED, PROBE_SENDING, PROBE_ANSWER };
+static uint8_t g_probe;
+
+// Time allowed for the keyboard to report its scan code set.
+#define SET_PROBE_TIMEOUT_MS 250
 
 static void clk_interrupt()
 {
     static uint8_t bitcount = 0;
     static uint8_t incoming = 0;
+    static uint8_t parity = 0;
     static uint32_t prev_ms = 0;
+    PROFILE_ISR_ENTER(entered);
+
+    if (ps2_tx_clock(&g_tx, g_head)) {
+        // Any partially received byte is retransmitted by the keyboard.
+        bitcount = 0;
+        incoming = 0;
+        parity = 0;
+        PROFILE_ISR_EXIT(PROFILE_ISR_KEYBOARD, entered);
+        return;
+    }
 
     const uint8_t val = digitalRead(g_data_pin);
     const uint32_t now_ms = millis();
     if (now_ms - prev_ms > 250) {
         bitcount = 0;
         incoming = 0;
+        parity = 0;
     }
     prev_ms = now_ms;
     const uint8_t n = bitcount - 1;
     if (n <= 7) {
         incoming |= (val << n);
     }
+    if (n <= 8)
+        parity ^= val;
     bitcount++;
     if (bitcount == 11) {
+        // Odd parity over data and parity bits, then a high stop bit.
+        if (!parity)
+            PerfCounters.ps2_parity_errors[PERF_KEYBOARD]++;
+        if (!val)
+            PerfCounters.ps2_framing_errors[PERF_KEYBOARD]++;
         uint8_t i = g_head + 1;
         if (i >= BUFFER_SIZE)
             i = 0;
@@ -47,10 +94,76 @@ static void clk_interrupt()
             g_head = i;
         } else {
             g_buffer_overflow = true;
+            PerfCounters.ps2_overflows[PERF_KEYBOARD]++;
         }
         bitcount = 0;
         incoming = 0;
+        parity = 0;
     }
+    PROFILE_ISR_EXIT(PROFILE_ISR_KEYBOARD, entered);
+}
+
+static void fall_back_to_set_2()
+{
+    g_probe = PROBE_NONE;
+    g_scan_code_set = 2;
+    g_cmds_wanted |= CMD_SET_2;
+}
+
+// Once the previous commands are through, or have failed, queue the next
+// ones, with the latest wanted LED state.
+static void send_commands()
+{
+    if (!ps2_tx_idle(&g_tx))
+        return;
+    const bool failed = g_tx.errors != g_cmds_errors;
+    if (g_probe == PROBE_SENDING) {
+        if (failed) {
+            fall_back_to_set_2();
+        } else {
+            g_probe = PROBE_ANSWER;
+            g_probe_ms = millis();
+        }
+    }
+    if (g_cmds_queued) {
+        if (failed)
+            g_cmds_wanted |= g_cmds_queued & ~(CMD_LEDS | CMD_ECHO);
+        else if (g_cmds_queued & CMD_LEDS)
+            g_leds_current = g_leds_sent;
+        g_cmds_queued = 0;
+    }
+    if (g_probe == PROBE_ANSWER)
+        return;
+    g_cmds_errors = g_tx.errors;
+    if (g_probe == PROBE_WANTED) {
+        g_probe = PROBE_SENDING;
+        ps2_tx_queue(&g_tx, 0xf0);  // select scan code set 3
+        ps2_tx_queue(&g_tx, 0x03);
+        ps2_tx_queue(&g_tx, 0xf0);  // get scan code set
+        ps2_tx_queue(&g_tx, 0x00);
+        return;
+    }
+    if (g_leds_wanted != g_leds_current)
+        g_cmds_wanted |= CMD_LEDS;
+    if (g_cmds_wanted & CMD_SET_2) {
+        ps2_tx_queue(&g_tx, 0xf0);  // select scan code set 2
+        ps2_tx_queue(&g_tx, 0x02);
+    }
+    if (g_cmds_wanted & CMD_MAKE_BREAK)
+        ps2_tx_queue(&g_tx, 0xf8);  // set all keys make/break
+    if (g_cmds_wanted & CMD_TYPEMATIC) {
+        ps2_tx_queue(&g_tx, 0xf3);  // set typematic rate/delay
+        ps2_tx_queue(&g_tx, g_typematic);
+    }
+    if (g_cmds_wanted & CMD_LEDS) {
+        g_leds_sent = g_leds_wanted;
+        ps2_tx_queue(&g_tx, 0xed);  // set LEDs
+        ps2_tx_queue(&g_tx, g_leds_sent);
+    }
+    if (g_cmds_wanted & CMD_ECHO)
+        ps2_tx_queue(&g_tx, 0xee);  // echo
+    g_cmds_queued = g_cmds_wanted;
+    g_cmds_wanted = 0;
 }
 
 PS2Keyboard::PS2Keyboard() = default;
@@ -61,14 +174,40 @@ uint8_t PS2Keyboard::read(bool *avail, bool *buffer_overflow)
     *buffer_overflow = g_buffer_overflow;
     g_buffer_overflow = false;
 
+    if (g_probe == PROBE_ANSWER && millis() - g_probe_ms > SET_PROBE_TIMEOUT_MS)
+        fall_back_to_set_2();
+
+    if (g_present)
+        send_commands();
+    ps2_tx_service(&g_tx);
+
     uint8_t i = g_tail;
+    const uint8_t waiting = (uint8_t)(g_head - i) % BUFFER_SIZE;
+    if (waiting > PerfCounters.ps2_ring_high[PERF_KEYBOARD])
+        PerfCounters.ps2_ring_high[PERF_KEYBOARD] = waiting;
     if (i == g_head)
         return 0;
     i++;
     if (i >= BUFFER_SIZE)
         i = 0;
     const uint8_t c = g_buffer[i];
+    const uint8_t pos = g_tail;
     g_tail = i;
+    if (ps2_tx_receive(&g_tx, c, pos))
+        return 0; // acknowledge of a command byte
+    if (c == 0xaa)
+        g_leds_current = 0;     // self-test turns all LEDs off
+    if (g_probe == PROBE_ANSWER) {
+        // Answer to "get scan code set", possibly translated by the keyboard.
+        if (c == 0x03 || c == 0x3f) {
+            g_probe = PROBE_NONE;
+            g_scan_code_set = 3;
+            g_cmds_wanted |= CMD_MAKE_BREAK;
+        } else {
+            fall_back_to_set_2();
+        }
+        return 0;
+    }
     *avail = true;
     return c;
 }
@@ -82,7 +221,7 @@ void PS2Keyboard::begin(const int clk_pin, const int data_pin)
     ps2_pull_high(clk_pin);
     ps2_pull_high(data_pin);
     delay(20);
-    if (ps2_write_byte_with_timeout(clk_pin, data_pin, 0xff, PS2_TIMEOUT)) return;  // send reset
+    if (ps2_write_byte_with_timeout(clk_pin, data_pin, 0xff, Settings.ps2_timeout_ms)) return;  // send reset
     //ps2_write_byte(clk_pin, data_pin, 0xff);  // send reset
 
     ps2_read_byte(clk_pin, data_pin);         // read ack
@@ -94,23 +233,43 @@ void PS2Keyboard::begin(const int clk_pin, const int data_pin)
     g_head = 0;
     g_tail = 0;
     g_buffer_overflow = false;
+    ps2_tx_init(&g_tx, clk_pin, data_pin);
+    g_present = true;
     attachInterrupt(digitalPinToInterrupt(clk_pin), clk_interrupt, FALLING);
 }
 
-void PS2Keyboard::set_caps_lock_led(const bool caps_lock_led)
+void PS2Keyboard::set_typematic(const uint8_t rate_delay)
 {
-#if 0
-    // Send LED change command.
-    ps2_write_byte(g_clk_pin, g_data_pin, 0xED);
-    delayMicroseconds(100);
-    // Read ack
-    ps2_read_byte(g_clk_pin, g_data_pin);
-    delayMicroseconds(100);
-    // Send new caps lock state
-    ps2_write_byte(g_clk_pin, g_data_pin, caps_lock_led ? 0x4 : 0);
-    delayMicroseconds(100);
-    // Read ack.
-    ps2_read_byte(g_clk_pin, g_data_pin);
-    delayMicroseconds(100);
-#endif
+    g_typematic = rate_delay;
+    g_cmds_wanted |= CMD_TYPEMATIC;
+}
+
+void PS2Keyboard::select_scan_code_set_3()
+{
+    g_scan_code_set = 2;        // until the keyboard confirms
+    g_cmds_wanted &= ~(CMD_SET_2 | CMD_MAKE_BREAK);
+    g_probe = PROBE_WANTED;
+}
+
+uint8_t PS2Keyboard::scan_code_set()
+{
+    return g_scan_code_set;
+}
+
+void PS2Keyboard::ping()
+{
+    g_cmds_wanted |= CMD_ECHO;
+}
+
+bool PS2Keyboard::lost()
+{
+    if (g_tx.timeouts == g_timeouts)
+        return false;
+    g_timeouts = g_tx.timeouts;
+    return true;
+}
+
+void PS2Keyboard::set_leds(const uint8_t leds)
+{
+    g_leds_wanted = leds;
 }
@@ -7,6 +7,10 @@
 
 #include <stdint.h>
 
+#define PS2_LED_SCROLL_LOCK 0x01
+#define PS2_LED_NUM_LOCK 0x02
+#define PS2_LED_CAPS_LOCK 0x04
+
 class PS2Keyboard
 {
 public:
@@ -14,7 +18,21 @@ public:
 
     static void begin(int clk_pin, int data_pin);
     static uint8_t read(bool *avail, bool *buffer_overflow);
-    static void set_caps_lock_led(bool caps_lock_led);
+    // Bit 0: Scroll Lock, bit 1: Num Lock, bit 2: Caps Lock. Changes made
+    // while an update is in flight are coalesced into the next one.
+    static void set_leds(uint8_t leds);
+    // Bits 6-5: delay (250 to 1000 ms), bits 4-0: rate (30 down to 2 repeats/s).
+    static void set_typematic(uint8_t rate_delay);
+    // Switch to scan code set 3 with all keys make/break only, if the
+    // keyboard supports it. Otherwise, stay in set 2.
+    static void select_scan_code_set_3();
+    // 2 or 3. Scan code set 3 has no 0xE0 prefixes and no typematic repeats.
+    static uint8_t scan_code_set();
+    // Send an echo, to find out whether the keyboard is still there.
+    static void ping();
+    // True once after the keyboard stopped answering a command, such as
+    // when it was unplugged.
+    static bool lost();
 };
 
 #endif // PS2_KEYBOARD_H
@@ -10,6 +10,9 @@
 #include <Arduino.h>
 
 #include "config.h"
+#include "perf.h"
+#include "profile.h"
+#include "settings.h"
 
 #define BUFFER_SIZE 128
 static volatile uint8_t g_buffer[BUFFER_SIZE];
@@ -18,26 +21,51 @@ static volatile bool g_buffer_overflow;
 static int g_clk_pin, g_data_pin;
 
 static uint8_t g_device_type;
+static ps2_tx_t g_tx;
+static bool g_present;
+// The last configuration sequence, kept to send it again if it fails.
+static uint8_t g_config[9], g_config_len;
+static bool g_config_in_flight;
+static uint8_t g_config_errors;
 
 static void clk_interrupt()
 {
     static uint8_t bitcount = 0;
     static uint8_t incoming = 0;
+    static uint8_t parity = 0;
     static uint32_t prev_ms = 0;
+    PROFILE_ISR_ENTER(entered);
+
+    if (ps2_tx_clock(&g_tx, g_head)) {
+        // Any partially received byte is retransmitted by the mouse.
+        bitcount = 0;
+        incoming = 0;
+        parity = 0;
+        PROFILE_ISR_EXIT(PROFILE_ISR_MOUSE, entered);
+        return;
+    }
 
     const uint8_t val = digitalRead(g_data_pin);
     const uint32_t now_ms = millis();
     if (now_ms - prev_ms > 250) {
         bitcount = 0;
         incoming = 0;
+        parity = 0;
     }
     prev_ms = now_ms;
     const uint8_t n = bitcount - 1;
     if (n <= 7) {
         incoming |= (val << n);
     }
+    if (n <= 8)
+        parity ^= val;
     bitcount++;
     if (bitcount == 11) {
+        // Odd parity over data and parity bits, then a high stop bit.
+        if (!parity)
+            PerfCounters.ps2_parity_errors[PERF_MOUSE]++;
+        if (!val)
+            PerfCounters.ps2_framing_errors[PERF_MOUSE]++;
         uint8_t i = g_head + 1;
         if (i >= BUFFER_SIZE)
             i = 0;
@@ -46,10 +74,33 @@ static void clk_interrupt()
             g_head = i;
         } else {
             g_buffer_overflow = true;
+            PerfCounters.ps2_overflows[PERF_MOUSE]++;
         }
         bitcount = 0;
         incoming = 0;
+        parity = 0;
     }
+    PROFILE_ISR_EXIT(PROFILE_ISR_MOUSE, entered);
+}
+
+static void queue_config()
+{
+    for (uint8_t i = 0; i < g_config_len; i++)
+        ps2_tx_queue(&g_tx, g_config[i]);
+    g_config_errors = g_tx.errors;
+    g_config_in_flight = true;
+}
+
+// A failed byte drops the rest of the sequence (ps2.h), which could leave
+// the mouse with reporting disabled: send all of it again.
+static void check_config()
+{
+    if (!g_config_in_flight || !ps2_tx_idle(&g_tx))
+        return;
+    if (g_tx.errors != g_config_errors)
+        queue_config();
+    else
+        g_config_in_flight = false;
 }
 
 PS2Mouse::PS2Mouse() = default;
@@ -60,14 +111,24 @@ uint8_t PS2Mouse::read(bool *avail, bool *buffer_overflow)
     *buffer_overflow = g_buffer_overflow;
     g_buffer_overflow = false;
 
+    if (g_present)
+        check_config();
+    ps2_tx_service(&g_tx);
+
     uint8_t i = g_tail;
+    const uint8_t waiting = (uint8_t)(g_head - i) % BUFFER_SIZE;
+    if (waiting > PerfCounters.ps2_ring_high[PERF_MOUSE])
+        PerfCounters.ps2_ring_high[PERF_MOUSE] = waiting;
     if (i == g_head)
         return 0;
     i++;
     if (i >= BUFFER_SIZE)
         i = 0;
     const uint8_t c = g_buffer[i];
+    const uint8_t pos = g_tail;
     g_tail = i;
+    if (ps2_tx_receive(&g_tx, c, pos))
+        return 0; // acknowledge of a command byte
     *avail = true;
     return c;
 }
@@ -81,7 +142,7 @@ void PS2Mouse::begin(const int clk_pin, const int data_pin)
     ps2_pull_high(clk_pin);
     ps2_pull_high(data_pin);
     delay(20);
-    if (ps2_write_byte_with_timeout(clk_pin, data_pin, 0xff, PS2_TIMEOUT)) return;  // send reset
+    if (ps2_write_byte_with_timeout(clk_pin, data_pin, 0xff, Settings.ps2_timeout_ms)) return;  // send reset
     ps2_read_byte(clk_pin, data_pin);         // read ack
     delay(20);
     ps2_read_byte(clk_pin, data_pin);         // ignore
@@ -97,5 +158,41 @@ void PS2Mouse::begin(const int clk_pin, const int data_pin)
     g_head = 0;
     g_tail = 0;
     g_buffer_overflow = false;
+    ps2_tx_init(&g_tx, clk_pin, data_pin);
+    g_present = true;
     attachInterrupt(digitalPinToInterrupt(clk_pin), clk_interrupt, FALLING);
 }
+
+bool PS2Mouse::configure(const uint8_t sample_rate, const uint8_t resolution, const bool scaling_2_1,
+                         const bool remote_mode)
+{
+    if (!g_present)
+        return true;
+    // Send the whole sequence in one go, or not at all.
+    if (!ps2_tx_idle(&g_tx))
+        return false;
+    // Stop streaming first so that acknowledges don't interleave with movement packets.
+    uint8_t n = 0;
+    g_config[n++] = 0xf5;                           // disable data reporting
+    g_config[n++] = 0xf3;                           // set sample rate
+    g_config[n++] = sample_rate;
+    g_config[n++] = 0xe8;                           // set resolution
+    g_config[n++] = resolution;
+    g_config[n++] = scaling_2_1 ? 0xe7 : 0xe6;      // set scaling
+    if (remote_mode) {
+        g_config[n++] = 0xf0;                       // set remote mode
+    } else {
+        g_config[n++] = 0xea;                       // set stream mode
+        g_config[n++] = 0xf4;                       // enable data reporting
+    }
+    g_config_len = n;
+    queue_config();
+    return true;
+}
+
+void PS2Mouse::request_data()
+{
+    // Don't pile up requests if the mouse is slow to answer.
+    if (g_present && ps2_tx_idle(&g_tx))
+        ps2_tx_queue(&g_tx, 0xeb);                  // read data
+}
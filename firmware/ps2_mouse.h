@@ -14,6 +14,10 @@ public:
 
     static void begin(int clk_pin, int data_pin);
     static uint8_t read(bool *avail, bool *buffer_overflow);
+    // Return false if a previous command sequence is still being sent; try again later.
+    static bool configure(uint8_t sample_rate, uint8_t resolution, bool scaling_2_1, bool remote_mode);
+    // In remote mode, ask the mouse for one movement packet.
+    static void request_data();
 };
 
 #endif // PS2_MOUSE_H
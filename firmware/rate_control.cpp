@@ -0,0 +1,90 @@
+// rate_control.cpp
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#include "rate_control.h"
+
+#include "config.h"
+#include "settings.h"
+#include "util.h"
+
+// First stretch the report tick, which only coalesces motion, then also
+// slow down the mouse so that fewer PS/2 packets have to be decoded.
+static const struct {
+    uint8_t report_interval_ms;
+    uint8_t mouse_rate;
+} levels[] = {
+    { 0, 200 },     // unrestricted
+    { 20, 200 },
+    { 40, 60 },
+    { 80, 40 },
+    { 160, 20 },
+};
+
+#define MAX_LEVEL (sizeof(levels) / sizeof(levels[0]) - 1)
+
+static uint8_t g_level;
+static uint8_t g_quiet_periods;
+static uint16_t g_bytes_sent;
+static unsigned long g_period_start_ms;
+
+void rate_control_byte_sent()
+{
+    g_bytes_sent++;
+}
+
+bool rate_control_update(const unsigned long now_ms, int queue_depth)
+{
+#if RATE_CONTROL_ENA
+    const unsigned long elapsed = now_ms - g_period_start_ms;
+    if (elapsed < RATE_CONTROL_PERIOD_MS)
+        return false;
+    g_period_start_ms = now_ms;
+    const uint16_t sent = g_bytes_sent;
+    g_bytes_sent = 0;
+    // The serial transmit buffer holds more than RATE_CONTROL_BACKLOG_MS of
+    // bytes at 9600 baud, so a backlog there counts as much as in the queue.
+    queue_depth += send_pending();
+
+    // Time needed to empty the queue at the drain rate seen over the last period.
+    unsigned long backlog_ms = 0;
+    if (queue_depth > 0)
+        backlog_ms = sent ? (unsigned long)queue_depth * elapsed / sent : ~0UL;
+
+    const uint8_t old_level = g_level;
+    if (backlog_ms > RATE_CONTROL_BACKLOG_MS) {
+        if (g_level < MAX_LEVEL)
+            g_level++;
+        g_quiet_periods = 0;
+    } else if (queue_depth == 0) {
+        if (g_level > 0 && ++g_quiet_periods >= RATE_CONTROL_QUIET_PERIODS) {
+            g_level--;
+            g_quiet_periods = 0;
+        }
+    } else {
+        g_quiet_periods = 0;
+    }
+    return levels[g_level].mouse_rate != levels[old_level].mouse_rate;
+#else
+    (void)now_ms;
+    (void)queue_depth;
+    return false;
+#endif
+}
+
+uint8_t rate_control_report_interval()
+{
+    const uint8_t interval = levels[g_level].report_interval_ms;
+    return interval > Settings.report_interval_ms ? interval : Settings.report_interval_ms;
+}
+
+uint8_t rate_control_mouse_rate(const uint8_t configured_rate)
+{
+    const uint8_t rate = levels[g_level].mouse_rate;
+    return rate < configured_rate ? rate : configured_rate;
+}
+
+uint8_t rate_control_level()
+{
+    return g_level;
+}
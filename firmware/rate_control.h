@@ -0,0 +1,24 @@
+// rate_control.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#ifndef RATE_CONTROL_H
+#define RATE_CONTROL_H
+
+#include <stdint.h>
+
+// Closed-loop control of the report tick and PS/2 mouse sample rate.
+// When the bytes waiting for the host, in the IKBD output queue and the
+// serial transmit buffer, take too long to drain, mouse data is produced
+// more slowly; once they stay drained, the rates go back up.
+
+// Call once for every byte sent to the host.
+void rate_control_byte_sent();
+// Call from the main loop with the depth of the IKBD output queue. Return
+// true if the mouse sample rate changed.
+bool rate_control_update(unsigned long now_ms, int queue_depth);
+uint8_t rate_control_report_interval();
+uint8_t rate_control_mouse_rate(uint8_t configured_rate);
+uint8_t rate_control_level();
+
+#endif // RATE_CONTROL_H
@@ -0,0 +1,210 @@
+// remap.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#include "remap.h"
+
+#include <string.h>
+
+#include "crc16.h"
+#include "eeprom.h"
+#include "eeprom_map.h"
+#include "hal.h"
+#include "ikbd.h"
+#include "keymap.h"
+
+// The map in RAM is the EEPROM image: version, a target per key code, the
+// macros and a CRC of all of these.
+#define IMAGE_KEYS 1
+#define IMAGE_MACROS (IMAGE_KEYS + REMAP_KEYS)
+#define IMAGE_CRC (IMAGE_MACROS + REMAP_MACROS * REMAP_MACRO_SIZE)
+#define IMAGE_SIZE (IMAGE_CRC + 2)
+
+#if IMAGE_SIZE > EEPROM_REMAP_SIZE
+#error "remap image doesn't fit its EEPROM region"
+#endif
+
+#define QUEUE_SIZE 4
+
+static uint8_t g_image[IMAGE_SIZE];
+// Next byte to save, IMAGE_SIZE when not saving.
+static uint8_t g_save_pos = IMAGE_SIZE;
+
+// Macros waiting to be played, the first one playing.
+static uint8_t g_queue[QUEUE_SIZE];
+static uint8_t g_queue_head, g_queue_count;
+// Copy of the macro playing, so that changing it can't leave keys down.
+static uint8_t g_playing[REMAP_MACRO_SIZE];
+static uint8_t g_step, g_tap;
+static bool g_active, g_releasing;
+// Keys held that play a macro, a bit per key code, so that typematic
+// repeats don't queue it again.
+static uint8_t g_held[REMAP_KEYS / 8];
+
+static uint16_t image_crc(void)
+{
+    uint16_t crc = 0xffff;
+    for (uint8_t i = 0; i < IMAGE_CRC; i++)
+        crc = crc16_update(crc, g_image[i]);
+    return crc;
+}
+
+static bool valid_key(const uint8_t code)
+{
+    return code != 0 && code < KEY_PS2_ONLY;
+}
+
+void remap_clear(void)
+{
+    memset(g_image, 0, sizeof(g_image));
+    g_image[0] = REMAP_VERSION;
+    if (remap_saving())
+        remap_save();
+}
+
+void remap_load(void)
+{
+    g_save_pos = IMAGE_SIZE;
+    for (uint8_t i = 0; i < IMAGE_SIZE; i++)
+        g_image[i] = hal_eeprom_read(EEPROM_REMAP_ADDR + i);
+    const uint16_t crc = image_crc();
+    if (g_image[0] != REMAP_VERSION || g_image[IMAGE_CRC] != crc >> 8 || g_image[IMAGE_CRC + 1] != (crc & 0xff))
+        remap_clear();
+}
+
+bool remap_set_key(const uint8_t key, const uint8_t target)
+{
+    if (key == 0 || key >= REMAP_KEYS)
+        return false;
+    if (!(target == 0 || valid_key(target) || target == REMAP_OFF ||
+          (target & REMAP_MACRO && (target & ~REMAP_MACRO) < REMAP_MACROS)))
+        return false;
+    // The release of a key held now would go to the new target.
+    if (g_image[IMAGE_KEYS + key] != target)
+        remap_release_all();
+    g_image[IMAGE_KEYS + key] = target;
+    if (remap_saving())
+        remap_save();
+    return true;
+}
+
+uint8_t remap_get_key(const uint8_t key)
+{
+    return key < REMAP_KEYS ? g_image[IMAGE_KEYS + key] : 0;
+}
+
+bool remap_set_macro(const uint8_t n, const uint8_t steps[REMAP_MACRO_SIZE])
+{
+    if (n >= REMAP_MACROS)
+        return false;
+    uint8_t i;
+    for (i = 0; i < REMAP_MACRO_SIZE && steps[i]; i++)
+        if (!valid_key(steps[i] & ~REMAP_HOLD))
+            return false;
+    uint8_t *macro = &g_image[IMAGE_MACROS + n * REMAP_MACRO_SIZE];
+    memset(macro, 0, REMAP_MACRO_SIZE);
+    memcpy(macro, steps, i);
+    if (remap_saving())
+        remap_save();
+    return true;
+}
+
+void remap_get_macro(const uint8_t n, uint8_t steps[REMAP_MACRO_SIZE])
+{
+    if (n < REMAP_MACROS)
+        memcpy(steps, &g_image[IMAGE_MACROS + n * REMAP_MACRO_SIZE], REMAP_MACRO_SIZE);
+    else
+        memset(steps, 0, REMAP_MACRO_SIZE);
+}
+
+uint8_t remap_key(const uint8_t key, const bool press)
+{
+    if (key >= REMAP_KEYS)
+        return 0;
+    const uint8_t target = g_image[IMAGE_KEYS + key];
+    if (target == 0)
+        return key;
+    if (target == REMAP_OFF)
+        return 0;
+    if (target & REMAP_MACRO) {
+        const uint8_t bit = 1 << (key & 7);
+        if (!press) {
+            g_held[key >> 3] &= ~bit;
+        } else if (!(g_held[key >> 3] & bit)) {
+            g_held[key >> 3] |= bit;
+            if (g_queue_count < QUEUE_SIZE) {
+                g_queue[(g_queue_head + g_queue_count) % QUEUE_SIZE] = target & ~REMAP_MACRO;
+                g_queue_count++;
+            }
+        }
+        return 0;
+    }
+    return target;
+}
+
+void remap_release_all(void)
+{
+    memset(g_held, 0, sizeof(g_held));
+    IKBD_ReleaseAllKeys();
+}
+
+void remap_save(void)
+{
+    g_image[0] = REMAP_VERSION;
+    const uint16_t crc = image_crc();
+    g_image[IMAGE_CRC] = crc >> 8;
+    g_image[IMAGE_CRC + 1] = crc & 0xff;
+    g_save_pos = 0;
+}
+
+bool remap_saving(void)
+{
+    return g_save_pos < IMAGE_SIZE;
+}
+
+// Send one byte of the macro playing: the press of each step, the release
+// of each tapped key right after, and at the end the releases of the held
+// keys, last first.
+static void play_macro(void)
+{
+    // Wait rather than have a release dropped for lack of room.
+    if (g_queue_count == 0 || SIZE_KEYBOARD_BUFFER - Keyboard.NbBytesInOutputBuffer < 2)
+        return;
+    if (!g_active) {
+        memcpy(g_playing, &g_image[IMAGE_MACROS + g_queue[g_queue_head] * REMAP_MACRO_SIZE], REMAP_MACRO_SIZE);
+        g_step = 0;
+        g_active = true;
+    }
+    if (g_tap) {
+        IKBD_PressSTKey(g_tap, false);
+        g_tap = 0;
+        return;
+    }
+    if (!g_releasing) {
+        if (g_step < REMAP_MACRO_SIZE && g_playing[g_step]) {
+            const uint8_t step = g_playing[g_step++];
+            IKBD_PressSTKey(step & ~REMAP_HOLD, true);
+            if (!(step & REMAP_HOLD))
+                g_tap = step;
+            return;
+        }
+        g_releasing = true;
+    }
+    while (g_step > 0) {
+        const uint8_t step = g_playing[--g_step];
+        if (step & REMAP_HOLD) {
+            IKBD_PressSTKey(step & ~REMAP_HOLD, false);
+            return;
+        }
+    }
+    g_active = false;
+    g_releasing = false;
+    g_queue_head = (g_queue_head + 1) % QUEUE_SIZE;
+    g_queue_count--;
+}
+
+void remap_poll(void)
+{
+    play_macro();
+    eeprom_sync(EEPROM_REMAP_ADDR, g_image, IMAGE_SIZE, &g_save_pos);
+}
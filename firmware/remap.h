@@ -0,0 +1,70 @@
+// remap.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#ifndef REMAP_H
+#define REMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Key remapping and macros, between the scan code translation (keymap.h)
+// and the IKBD. Each key code, an ST scan code or a KEY_PS2_ONLY code,
+// can be sent as another ST key, dropped or made to play a macro: a short
+// sequence of ST key strokes, queued and sent a byte per main loop pass.
+// The map lives in RAM, loaded from EEPROM at power up, and is changed
+// with the vendor IKBD commands 0x38 and 0x39 and saved with 0x37.
+
+#define REMAP_VERSION 1
+
+#define REMAP_KEYS 128
+#define REMAP_MACROS 8
+#define REMAP_MACRO_SIZE 5
+
+// Targets: 0 leaves the key alone, 1 to 0x72 sends that ST key instead.
+#define REMAP_OFF 0x7F                  // drop the key
+#define REMAP_MACRO 0x80                // | n: play macro n when pressed
+
+// Macro steps: an ST scan code is pressed and released, one with
+// REMAP_HOLD is pressed and held until the end of the macro (modifiers).
+// 0 ends a macro shorter than REMAP_MACRO_SIZE.
+#define REMAP_HOLD 0x80
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Load the map saved in EEPROM, or clear it if there is none that checks
+// out. Drops a save still under way.
+void remap_load(void);
+void remap_clear(void);
+
+// False if the key or target is out of range.
+bool remap_set_key(uint8_t key, uint8_t target);
+uint8_t remap_get_key(uint8_t key);
+// False if the macro number or a step is out of range.
+bool remap_set_macro(uint8_t n, const uint8_t steps[REMAP_MACRO_SIZE]);
+void remap_get_macro(uint8_t n, uint8_t steps[REMAP_MACRO_SIZE]);
+
+// ST scan code to send for a key press or release, or 0 for none (the key
+// is dropped, or a macro was queued). A macro is queued on the first press
+// of its key only, not on the typematic repeats.
+uint8_t remap_key(uint8_t key, bool press);
+// Release every ST key and forget the macro keys held: after lost key
+// events, or when the map or the layout changes with keys held, which
+// would send their releases to other ST keys. Changing a key's target
+// does this itself.
+void remap_release_all(void);
+
+// Queue the map for saving, written a byte at a time by remap_poll().
+void remap_save(void);
+bool remap_saving(void);
+
+// Send the next byte of a queued macro, and write the next byte of a save.
+void remap_poll(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // REMAP_H
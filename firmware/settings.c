@@ -0,0 +1,268 @@
+// settings.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#include "settings.h"
+
+#include "config.h"
+#include "crc16.h"
+#include "eeprom.h"
+#include "eeprom_map.h"
+#include "hal.h"
+#include "keymap.h"
+#include "watchdog.h"
+
+// Each save goes to the slot after the last one, so that the EEPROM
+// cells wear evenly and an interrupted save leaves the previous slot
+// intact. A slot holds the version, a sequence number telling the newest
+// slot, the payload and a CRC of all three.
+#define SLOT_SIZE 16
+#define SLOT_COUNT (EEPROM_SETTINGS_SIZE / SLOT_SIZE)
+#define SLOT_PAYLOAD 2
+#define SLOT_CRC (SLOT_PAYLOAD + SETTINGS_PAYLOAD_SIZE)
+
+#define DEFAULT_FLAGS                                                                                         \
+    ((KEYBOARD_ENA ? SETTINGS_KEYBOARD : 0) | (MOUSE_ENA ? SETTINGS_MOUSE : 0) |                              \
+     (PS2_KEYBOARD_SLOW_TYPEMATIC ? SETTINGS_SLOW_TYPEMATIC : 0) | (PS2_KEYBOARD_SET3 ? SETTINGS_SET3 : 0))
+
+#define DEFAULTS                                                                                              \
+    {                                                                                                         \
+        SERIAL_BAUD_RATE, PS2_TIMEOUT, DEFAULT_FLAGS, IKBD_REPORT_INTERVAL_MS, PS2_MOUSE_SAMPLE_RATE,         \
+            PS2_MOUSE_RESOLUTION, PS2_MOUSE_SCALING, PS2_MOUSE_REMOTE_MODE, KEYBOARD_LAYOUT                   \
+    }
+
+SETTINGS Settings = DEFAULTS;
+static const SETTINGS defaults = DEFAULTS;
+
+#if SERIAL_BAUD_RATE > SERIAL_BAUD_RATE_MAX
+#error "SERIAL_BAUD_RATE is over SERIAL_BAUD_RATE_MAX"
+#endif
+
+// Standard rates that the UART makes exactly from the 7.3728 MHz crystal.
+// Any other rate could leave a saved setting the host can't talk at.
+static const uint32_t baud_rates[] = {
+    300, 600, 1200, 2400, 4800, 9600, 14400, 19200, 28800, 38400, 57600, 76800, 115200, 230400, 460800
+};
+
+// Payload bytes of each field.
+static const uint8_t field_sizes[SETTING_COUNT] = { 3, 2, 1, 1, 1, 1, 1, 1, 1 };
+
+static uint8_t g_source = SETTINGS_FROM_DEFAULTS;
+static uint8_t g_boot_flags = DEFAULT_FLAGS;
+// Slot last loaded or saved; the next save goes to the one after.
+static uint8_t g_slot = SLOT_COUNT - 1, g_sequence;
+// Slot being saved, written from g_pending_pos on.
+static uint8_t g_pending[SLOT_SIZE];
+static uint8_t g_pending_slot, g_pending_pos = SLOT_SIZE;
+
+static uint32_t get_field(const SETTINGS *s, const uint8_t field)
+{
+    switch (field) {
+    case SETTING_BAUD_RATE: return s->baud_rate;
+    case SETTING_PS2_TIMEOUT: return s->ps2_timeout_ms;
+    case SETTING_FLAGS: return s->flags;
+    case SETTING_REPORT_INTERVAL: return s->report_interval_ms;
+    case SETTING_MOUSE_SAMPLE_RATE: return s->mouse_sample_rate;
+    case SETTING_MOUSE_RESOLUTION: return s->mouse_resolution;
+    case SETTING_MOUSE_SCALING: return s->mouse_scaling;
+    case SETTING_MOUSE_REMOTE_MODE: return s->mouse_remote_mode;
+    default: return s->keyboard_layout;
+    }
+}
+
+// Store a value if it is in range for its field.
+static bool set_field(SETTINGS *s, const uint8_t field, const uint32_t value)
+{
+    switch (field) {
+    case SETTING_BAUD_RATE:
+        if (value > SERIAL_BAUD_RATE_MAX) return false;
+        for (uint8_t i = 0; i < sizeof(baud_rates) / sizeof(baud_rates[0]); i++) {
+            if (baud_rates[i] == value) {
+                s->baud_rate = value;
+                return true;
+            }
+        }
+        return false;
+    case SETTING_PS2_TIMEOUT:
+        // Short enough for the watchdog to let setup() wait for a device.
+        if (value == 0 || value > WATCHDOG_SETUP_MS / 2) return false;
+        s->ps2_timeout_ms = value;
+        return true;
+    case SETTING_FLAGS:
+        if (value > 0x0f) return false;
+        s->flags = value;
+        return true;
+    case SETTING_REPORT_INTERVAL:
+        if (value == 0 || value > 0xff) return false;
+        s->report_interval_ms = value;
+        return true;
+    case SETTING_MOUSE_SAMPLE_RATE:
+        switch (value) {
+        case 10: case 20: case 40: case 60: case 80: case 100: case 200:
+            s->mouse_sample_rate = value;
+            return true;
+        default:
+            return false;
+        }
+    case SETTING_MOUSE_RESOLUTION:
+        if (value > 3) return false;
+        s->mouse_resolution = value;
+        return true;
+    case SETTING_MOUSE_SCALING:
+        if (value > 1) return false;
+        s->mouse_scaling = value;
+        return true;
+    case SETTING_MOUSE_REMOTE_MODE:
+        if (value > 1) return false;
+        s->mouse_remote_mode = value;
+        return true;
+    case SETTING_KEYBOARD_LAYOUT:
+        if (value >= KEYMAP_LAYOUT_COUNT) return false;
+        s->keyboard_layout = value;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static uint16_t slot_addr(const uint8_t slot)
+{
+    return EEPROM_SETTINGS_ADDR + slot * SLOT_SIZE;
+}
+
+// Read a slot into data, checking its CRC.
+static bool read_slot(const uint8_t slot, uint8_t data[SLOT_SIZE])
+{
+    uint16_t crc = 0xffff;
+    for (uint8_t i = 0; i < SLOT_SIZE; i++) {
+        data[i] = hal_eeprom_read(slot_addr(slot) + i);
+        if (i < SLOT_CRC)
+            crc = crc16_update(crc, data[i]);
+    }
+    return data[SLOT_CRC] == crc >> 8 && data[SLOT_CRC + 1] == (crc & 0xff);
+}
+
+// Unpack a payload, if every value is in range.
+static bool deserialize(const uint8_t *p, SETTINGS *s)
+{
+    for (uint8_t field = 0; field < SETTING_COUNT; field++) {
+        uint32_t value = 0;
+        for (uint8_t i = 0; i < field_sizes[field]; i++)
+            value = value << 8 | *p++;
+        if (!set_field(s, field, value))
+            return false;
+    }
+    return true;
+}
+
+void settings_serialize(uint8_t payload[SETTINGS_PAYLOAD_SIZE])
+{
+    for (uint8_t field = 0; field < SETTING_COUNT; field++) {
+        const uint32_t value = get_field(&Settings, field);
+        for (uint8_t i = field_sizes[field]; i-- > 0;)
+            *payload++ = value >> (8 * i);
+    }
+}
+
+void settings_load(void)
+{
+    Settings = defaults;
+    g_source = SETTINGS_FROM_DEFAULTS;
+    g_pending_pos = SLOT_SIZE;
+    // Try the slots from the newest down, which usually means reading
+    // just the headers and one slot.
+    uint16_t rejected = 0;
+    for (;;) {
+        int8_t best = -1;
+        uint8_t best_sequence = 0;
+        for (uint8_t slot = 0; slot < SLOT_COUNT; slot++) {
+            if (rejected & (1u << slot) || hal_eeprom_read(slot_addr(slot)) != SETTINGS_VERSION)
+                continue;
+            const uint8_t sequence = hal_eeprom_read(slot_addr(slot) + 1);
+            if (best < 0 || (int8_t)(sequence - best_sequence) > 0) {
+                best = slot;
+                best_sequence = sequence;
+            }
+        }
+        if (best < 0)
+            return;
+        uint8_t data[SLOT_SIZE];
+        SETTINGS loaded = Settings;
+        if (read_slot(best, data) && deserialize(data + SLOT_PAYLOAD, &loaded)) {
+            Settings = loaded;
+            g_slot = best;
+            g_sequence = best_sequence;
+            g_source = SETTINGS_FROM_EEPROM;
+            return;
+        }
+        rejected |= 1u << best;
+    }
+}
+
+void settings_boot(void)
+{
+    settings_load();
+    g_boot_flags = Settings.flags;
+}
+
+uint8_t settings_boot_flags(void)
+{
+    return g_boot_flags;
+}
+
+void settings_defaults(void)
+{
+    Settings = defaults;
+    g_source = SETTINGS_CHANGED;
+}
+
+bool settings_set(const uint8_t field, const uint32_t value)
+{
+    if (!set_field(&Settings, field, value))
+        return false;
+    g_source = SETTINGS_CHANGED;
+    return true;
+}
+
+void settings_save(void)
+{
+    // A save already under way is restarted in the same slot.
+    if (g_pending_pos == SLOT_SIZE)
+        g_pending_slot = (g_slot + 1) % SLOT_COUNT;
+    g_pending[0] = SETTINGS_VERSION;
+    g_pending[1] = g_sequence + 1;
+    settings_serialize(g_pending + SLOT_PAYLOAD);
+    uint16_t crc = 0xffff;
+    for (uint8_t i = 0; i < SLOT_CRC; i++)
+        crc = crc16_update(crc, g_pending[i]);
+    g_pending[SLOT_CRC] = crc >> 8;
+    g_pending[SLOT_CRC + 1] = crc & 0xff;
+    g_pending_pos = 0;
+    g_source = SETTINGS_FROM_EEPROM;
+}
+
+void settings_poll(void)
+{
+    if (g_pending_pos == SLOT_SIZE)
+        return;
+    if (eeprom_sync(slot_addr(g_pending_slot), g_pending, SLOT_SIZE, &g_pending_pos)) {
+        // The next save goes to the next slot.
+        g_slot = g_pending_slot;
+        g_sequence = g_pending[1];
+    }
+}
+
+uint8_t settings_source(void)
+{
+    return g_source;
+}
+
+bool settings_saving(void)
+{
+    return g_pending_pos < SLOT_SIZE;
+}
+
+uint8_t settings_sequence(void)
+{
+    return g_sequence;
+}
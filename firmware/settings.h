@@ -0,0 +1,92 @@
+// settings.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Installation settings saved in EEPROM, so that a unit can be tuned for
+// its host without new firmware. The config.h values are the defaults,
+// used until settings are saved and whenever the saved ones don't check
+// out. Changed and read with the vendor IKBD commands 0x36, 0x37 and 0xB6.
+
+#define SETTINGS_VERSION 2
+
+// Settings.flags
+#define SETTINGS_KEYBOARD 0x01          // use the PS/2 keyboard (KEYBOARD_ENA)
+#define SETTINGS_MOUSE 0x02             // use the PS/2 mouse (MOUSE_ENA)
+#define SETTINGS_SLOW_TYPEMATIC 0x04    // PS2_KEYBOARD_SLOW_TYPEMATIC
+#define SETTINGS_SET3 0x08              // PS2_KEYBOARD_SET3
+
+typedef struct {
+    uint32_t baud_rate;                 // host link
+    uint16_t ps2_timeout_ms;            // wait for a device to answer a reset
+    uint8_t flags;                      // SETTINGS_xxx
+    uint8_t report_interval_ms;         // automatic reports, when not throttled
+    uint8_t mouse_sample_rate;          // PS/2 mouse power-up parameters, as
+    uint8_t mouse_resolution;           // set by IKBD command 0x30
+    uint8_t mouse_scaling;
+    uint8_t mouse_remote_mode;
+    uint8_t keyboard_layout;            // KEYMAP_LAYOUT_xxx
+} SETTINGS;
+
+// Fields for settings_set(), in the order of the SETTINGS members.
+enum {
+    SETTING_BAUD_RATE,
+    SETTING_PS2_TIMEOUT,
+    SETTING_FLAGS,
+    SETTING_REPORT_INTERVAL,
+    SETTING_MOUSE_SAMPLE_RATE,
+    SETTING_MOUSE_RESOLUTION,
+    SETTING_MOUSE_SCALING,
+    SETTING_MOUSE_REMOTE_MODE,
+    SETTING_KEYBOARD_LAYOUT,
+    SETTING_COUNT
+};
+
+// Where the settings in use come from.
+enum {
+    SETTINGS_FROM_DEFAULTS,
+    SETTINGS_FROM_EEPROM,
+    SETTINGS_CHANGED,                   // not saved yet
+};
+
+// SETTINGS members, big endian, the baud rate in 3 bytes.
+#define SETTINGS_PAYLOAD_SIZE 12
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern SETTINGS Settings;
+
+// Load the newest saved settings that check out, or the defaults. Only
+// reads the slot headers and one slot. Drops a save still under way.
+void settings_load(void);
+// settings_load() at power up. The flags loaded then are the ones the
+// PS/2 devices are started and set up with: changed flags only apply at
+// the next power up.
+void settings_boot(void);
+uint8_t settings_boot_flags(void);
+void settings_defaults(void);
+// Change one setting. False if the value is out of range.
+bool settings_set(uint8_t field, uint32_t value);
+// Queue Settings for saving: settings_poll() writes them a byte at a time,
+// without waiting for the EEPROM.
+void settings_save(void);
+void settings_poll(void);
+
+uint8_t settings_source(void);
+bool settings_saving(void);
+// Sequence number of the slot last loaded or saved.
+uint8_t settings_sequence(void);
+void settings_serialize(uint8_t payload[SETTINGS_PAYLOAD_SIZE]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SETTINGS_H
@@ -0,0 +1,348 @@
+// ikbd_latency.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// End-to-end input latency of the firmware on simavr: from the last PS/2
+// clock edge of a key event, a joystick pin change or a host command, to
+// the end of the stop bit of the matching IKBD byte on the serial line.
+// Standard scenarios are run and p50/p99/max latencies and dropped events
+// are reported for each.
+//
+// Usage: ikbd_latency [-n scale] [-p99 ms] ikbd.elf
+// With -p99, exit with status 1 if any p99 is above the limit or any event
+// is dropped, so that the suite can gate changes.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ikbd.h"
+#include "ikbd_packet.h"
+#include "joy.h"
+#include "sim.h"
+
+#define BOOT_MS 300
+// Output later than this is not a response any more.
+#define DROP_MS 500.0
+#define SLICE_MS 0.05
+
+typedef enum { PROBE_KEY, PROBE_JOYSTICK, PROBE_INTERROGATE, PROBE_KINDS } probe_kind_t;
+
+static const char *const probe_names[PROBE_KINDS] = { "key", "joystick", "interrogate" };
+
+typedef struct {
+    probe_kind_t kind;
+    uint8_t expect;
+    avr_cycle_count_t start;    // when the stimulus reached the firmware
+    bool delivered;
+} probe_t;
+
+typedef struct {
+    sim_t sim;
+    probe_t *probes;
+    unsigned num_probes, capacity;
+    // Joystick monitoring sends headerless pairs from here on.
+    bool monitoring;
+    unsigned monitoring_from;
+    bool ok;
+} bench_t;
+
+static uint32_t g_seed = 1;
+
+static uint32_t random_between(const uint32_t lo, const uint32_t hi)
+{
+    g_seed = g_seed * 1103515245u + 12345u;
+    return lo + (g_seed >> 16) % (hi - lo + 1);
+}
+
+static probe_t *add_probe(bench_t *b, const probe_kind_t kind, const uint8_t expect)
+{
+    if (b->num_probes == b->capacity) {
+        b->capacity = b->capacity ? b->capacity * 2 : 1024;
+        b->probes = realloc(b->probes, b->capacity * sizeof(*b->probes));
+        if (!b->probes)
+            abort();
+    }
+    probe_t *p = &b->probes[b->num_probes++];
+    *p = (probe_t){ .kind = kind, .expect = expect, .start = b->sim.avr->cycle };
+    return p;
+}
+
+static avr_cycle_count_t now(const bench_t *b)
+{
+    return b->sim.avr->cycle;
+}
+
+// Run in small steps so that key events get the exact cycle their last
+// frame ended.
+static void run_to(bench_t *b, const avr_cycle_count_t cycle)
+{
+    while (b->ok && now(b) < cycle) {
+        avr_cycle_count_t until = now(b) + sim_ms_to_cycles(SLICE_MS);
+        b->ok = sim_run_until(&b->sim, until < cycle ? until : cycle);
+        if (ps2_device_idle(&b->sim.keyboard)) {
+            for (unsigned i = b->num_probes; i-- > 0;) {
+                probe_t *p = &b->probes[i];
+                if (p->kind == PROBE_KEY && !p->delivered) {
+                    p->delivered = true;
+                    p->start = b->sim.keyboard.last_sent_cycle;
+                }
+            }
+        }
+    }
+}
+
+static void host_send(bench_t *b, const uint8_t *bytes, const unsigned count)
+{
+    for (unsigned i = 0; i < count; i++)
+        sim_uart_send(&b->sim, bytes[i]);
+}
+
+// Set 2 make codes of A to P and the matching Atari ST scan codes.
+static const uint8_t set2_codes[] = { 0x1c, 0x32, 0x21, 0x23, 0x24, 0x2b, 0x34, 0x33,
+                                      0x43, 0x3b, 0x42, 0x4b, 0x3a, 0x31, 0x44, 0x4d };
+static const uint8_t st_codes[] = { 0x1e, 0x30, 0x2e, 0x20, 0x12, 0x21, 0x22, 0x23,
+                                    0x17, 0x24, 0x25, 0x26, 0x32, 0x31, 0x18, 0x19 };
+#define NUM_KEYS (sizeof(set2_codes) / sizeof(set2_codes[0]))
+
+typedef struct {
+    unsigned keys_left;
+    bool key_down;
+    unsigned key;
+    avr_cycle_count_t next_key;
+    bool mouse;
+    avr_cycle_count_t next_mouse;
+    unsigned joystick_changes_left;
+    bool joystick_up;
+    avr_cycle_count_t next_joystick;
+    unsigned interrogations_left;
+    avr_cycle_count_t next_interrogate;
+} activity_t;
+
+static avr_cycle_count_t ms_from_now(const bench_t *b, const uint32_t lo, const uint32_t hi)
+{
+    return now(b) + sim_ms_to_cycles(random_between(lo, hi));
+}
+
+// Drive all the activity until every stream is done.
+static void run_activity(bench_t *b, activity_t *a)
+{
+    a->next_key = a->next_mouse = a->next_joystick = a->next_interrogate = now(b);
+    while (b->ok && (a->keys_left || a->key_down || a->joystick_changes_left || a->interrogations_left)) {
+        avr_cycle_count_t next = (avr_cycle_count_t)-1;
+        if (a->keys_left || a->key_down)
+            next = a->next_key;
+        if (a->mouse && a->next_mouse < next)
+            next = a->next_mouse;
+        if (a->joystick_changes_left && a->next_joystick < next)
+            next = a->next_joystick;
+        if (a->interrogations_left && a->next_interrogate < next)
+            next = a->next_interrogate;
+        run_to(b, next);
+
+        if ((a->keys_left || a->key_down) && now(b) >= a->next_key) {
+            // Hold keys 30-100 ms, 40-160 ms between key strokes.
+            const uint8_t code = set2_codes[a->key % NUM_KEYS];
+            if (!a->key_down) {
+                ps2_device_send(&b->sim.keyboard, &code, 1);
+                add_probe(b, PROBE_KEY, st_codes[a->key % NUM_KEYS]);
+                a->key_down = true;
+                a->keys_left--;
+                a->next_key = ms_from_now(b, 30, 100);
+            } else {
+                const uint8_t brk[2] = { 0xf0, code };
+                ps2_device_send(&b->sim.keyboard, brk, 2);
+                add_probe(b, PROBE_KEY, st_codes[a->key % NUM_KEYS] | 0x80);
+                a->key_down = false;
+                a->key++;
+                a->next_key = ms_from_now(b, 40, 160);
+            }
+        }
+        if (a->mouse && now(b) >= a->next_mouse) {
+            // 200 samples/s of fast motion.
+            const int dx = (int)random_between(0, 240) - 120, dy = (int)random_between(0, 240) - 120;
+            ps2_device_move(&b->sim.mouse, dx, dy, 0);
+            a->next_mouse += sim_ms_to_cycles(5);
+        }
+        if (a->joystick_changes_left && now(b) >= a->next_joystick) {
+            a->joystick_up = !a->joystick_up;
+            sim_set_joystick(&b->sim, 1, a->joystick_up ? 0x3f & ~GPIO_MASK_UP : 0x3f);
+            add_probe(b, PROBE_JOYSTICK, a->joystick_up ? ATARIJOY_BITMASK_UP : 0)->delivered = true;
+            a->joystick_changes_left--;
+            a->next_joystick = ms_from_now(b, 20, 60);
+        }
+        if (a->interrogations_left && now(b) >= a->next_interrogate) {
+            const uint8_t cmd = 0x0d;
+            host_send(b, &cmd, 1);
+            add_probe(b, PROBE_INTERROGATE, 0xf7)->delivered = true;
+            a->interrogations_left--;
+            a->next_interrogate = ms_from_now(b, 15, 30);
+        }
+    }
+    // Let the output drain.
+    run_to(b, now(b) + sim_ms_to_cycles(DROP_MS));
+}
+
+static void idle_typing(bench_t *b, const unsigned scale)
+{
+    activity_t a = { .keys_left = 100 * scale };
+    run_activity(b, &a);
+}
+
+static void mouse_flood_typing(bench_t *b, const unsigned scale)
+{
+    activity_t a = { .keys_left = 100 * scale, .mouse = true };
+    run_activity(b, &a);
+}
+
+static void joystick_monitoring(bench_t *b, const unsigned scale)
+{
+    static const uint8_t monitor[] = { 0x17, 0x00 };   // as fast as possible
+    b->monitoring_from = b->sim.uart_count;
+    b->monitoring = true;
+    host_send(b, monitor, sizeof(monitor));
+    run_to(b, now(b) + sim_ms_to_cycles(50));
+    activity_t a = { .joystick_changes_left = 100 * scale };
+    run_activity(b, &a);
+}
+
+static void interrogate_in_motion(bench_t *b, const unsigned scale)
+{
+    static const uint8_t absolute[] = { 0x09, 0x01, 0x40, 0x00, 0xc8 };  // 320x200
+    host_send(b, absolute, sizeof(absolute));
+    run_to(b, now(b) + sim_ms_to_cycles(20));
+    activity_t a = { .keys_left = 50 * scale, .mouse = true, .interrogations_left = 200 * scale };
+    run_activity(b, &a);
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(bench_t *b, unsigned scale);
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    { "idle typing", idle_typing },
+    { "mouse flood + typing", mouse_flood_typing },
+    { "joystick monitoring", joystick_monitoring },
+    { "interrogate in motion", interrogate_in_motion },
+};
+
+// Cycle at which the response to a probe was on the wire, or 0 if none.
+static avr_cycle_count_t find_response(const bench_t *b, const probe_t *p)
+{
+    const sim_t *sim = &b->sim;
+    const avr_cycle_count_t limit = p->start + sim_ms_to_cycles(DROP_MS);
+    unsigned i = b->monitoring ? b->monitoring_from : 0;
+    for (; i < sim->uart_count && sim->uart[i].cycle <= limit;) {
+        const unsigned len = b->monitoring ? 2 : ikbd_packet_length(sim->uart[i].c);
+        if (i + len > sim->uart_count)
+            break;
+        const sim_uart_byte_t *last = &sim->uart[i + len - 1];
+        if (sim->uart[i].cycle >= p->start) {
+            const uint8_t c = sim->uart[i].c;
+            switch (p->kind) {
+            case PROBE_KEY:
+                if (len == 1 && c == p->expect)
+                    return last->stop;
+                break;
+            case PROBE_JOYSTICK:
+                if (b->monitoring ? (last->c & 0x0f) == p->expect : c == 0xff && last->c == p->expect)
+                    return last->stop;
+                break;
+            case PROBE_INTERROGATE:
+                if (c == p->expect)
+                    return last->stop;
+                break;
+            default:
+                break;
+            }
+        }
+        i += len;
+    }
+    return 0;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    const double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile(const double *sorted, const unsigned n, const double q)
+{
+    unsigned i = (unsigned)ceil(q * n);
+    return sorted[i > 0 ? i - 1 : 0];
+}
+
+// Return false if a limit was broken.
+static bool report(const bench_t *b, const char *name, const double p99_limit)
+{
+    bool pass = b->ok;
+    double *ms = malloc((b->num_probes + 1) * sizeof(*ms));
+    for (int kind = 0; kind < PROBE_KINDS; kind++) {
+        unsigned n = 0, total = 0, dropped = 0;
+        for (unsigned i = 0; i < b->num_probes; i++) {
+            const probe_t *p = &b->probes[i];
+            if (p->kind != (probe_kind_t)kind)
+                continue;
+            total++;
+            const avr_cycle_count_t t = p->delivered ? find_response(b, p) : 0;
+            if (t == 0)
+                dropped++;
+            else
+                ms[n++] = sim_cycles_to_ms(t - p->start);
+        }
+        if (total == 0)
+            continue;
+        qsort(ms, n, sizeof(*ms), compare_doubles);
+        printf("%-22s %-12s %6u %7u", name, probe_names[kind], total, dropped);
+        if (n)
+            printf(" %8.3f %8.3f %8.3f\n", percentile(ms, n, 0.5), percentile(ms, n, 0.99), ms[n - 1]);
+        else
+            printf(" %8s %8s %8s\n", "-", "-", "-");
+        if (p99_limit > 0 && (dropped || (n && percentile(ms, n, 0.99) > p99_limit)))
+            pass = false;
+    }
+    free(ms);
+    if (!b->ok)
+        printf("%-22s CPU stopped at %.3f ms\n", name, sim_cycles_to_ms(b->sim.avr->cycle));
+    return pass;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned scale = 1;
+    double p99_limit = 0;
+    int arg = 1;
+    while (arg + 1 < argc && argv[arg][0] == '-') {
+        if (strcmp(argv[arg], "-n") == 0)
+            scale = (unsigned)strtoul(argv[arg + 1], NULL, 0);
+        else if (strcmp(argv[arg], "-p99") == 0)
+            p99_limit = strtod(argv[arg + 1], NULL);
+        else
+            break;
+        arg += 2;
+    }
+    if (argc - arg != 1 || scale == 0) {
+        fprintf(stderr, "usage: %s [-n scale] [-p99 ms] ikbd.elf\n", argv[0]);
+        return 2;
+    }
+
+    bool pass = true;
+    printf("%-22s %-12s %6s %7s %8s %8s %8s\n", "scenario", "event", "count", "dropped", "p50 ms", "p99 ms",
+           "max ms");
+    for (unsigned i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        bench_t b = { .ok = true };
+        if (!sim_init(&b.sim, argv[arg]))
+            return 1;
+        run_to(&b, sim_ms_to_cycles(BOOT_MS));
+        scenarios[i].run(&b, scale);
+        pass &= report(&b, scenarios[i].name, p99_limit);
+        free(b.probes);
+        sim_free(&b.sim);
+    }
+    if (p99_limit > 0)
+        printf("\n%s (p99 limit %.3f ms)\n", pass ? "PASS" : "FAIL", p99_limit);
+    return pass ? 0 : 1;
+}
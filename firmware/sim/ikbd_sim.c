@@ -0,0 +1,270 @@
+// ikbd_sim.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// Runs the firmware ELF on simavr against a stimulus script and reports
+// latency, throughput and interrupt load, in simulated CPU cycles.
+//
+// Usage: ikbd_sim [-v] ikbd.elf script
+//
+// Each script line is "<time in ms> <command> [arguments]", in time order:
+//   key <hex bytes>           bytes sent by the keyboard (set 2 scan codes)
+//   mouse <dx> <dy> [buttons] mouse movement, buttons as in the PS/2 packet
+//   joy <port> <hex value>    joystick port pins, bits 5:0 active low
+//   host <hex bytes>          bytes sent by the Atari to the IKBD
+//   end                       stop here (default: 100 ms after the last event)
+// '#' starts a comment.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+
+#define MAX_EVENTS 4096
+#define MAX_EVENT_BYTES 16
+// Granularity at which device deliveries are noticed.
+#define SLICE_MS 0.1
+
+typedef enum { EV_KEY, EV_MOUSE, EV_JOY, EV_HOST, EV_END, EV_KINDS } event_kind_t;
+
+static const char *const kind_names[EV_KINDS] = { "key", "mouse", "joy", "host", "end" };
+
+typedef struct {
+    event_kind_t kind;
+    avr_cycle_count_t cycle;
+    uint8_t bytes[MAX_EVENT_BYTES];
+    unsigned count;
+    int args[3];
+    int line;
+    // Filled in while running.
+    bool injected, delivered;
+    avr_cycle_count_t delivered_cycle;
+} event_t;
+
+static event_t g_events[MAX_EVENTS];
+static unsigned g_event_count;
+
+static bool parse_script(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    char line[256];
+    int n = 0;
+    double prev_ms = 0;
+    while (fgets(line, sizeof(line), f)) {
+        n++;
+        char *hash = strchr(line, '#');
+        if (hash)
+            *hash = '\0';
+        char *tok = strtok(line, " \t\r\n");
+        if (!tok)
+            continue;
+        if (g_event_count == MAX_EVENTS) {
+            fprintf(stderr, "%s:%d: too many events\n", path, n);
+            break;
+        }
+        event_t *ev = &g_events[g_event_count];
+        const double ms = strtod(tok, NULL);
+        if (ms < prev_ms) {
+            fprintf(stderr, "%s:%d: events out of order\n", path, n);
+            fclose(f);
+            return false;
+        }
+        prev_ms = ms;
+        ev->cycle = sim_ms_to_cycles(ms);
+        ev->line = n;
+        const char *cmd = strtok(NULL, " \t\r\n");
+        int kind = 0;
+        while (kind < EV_KINDS && (!cmd || strcmp(cmd, kind_names[kind]) != 0))
+            kind++;
+        if (kind == EV_KINDS) {
+            fprintf(stderr, "%s:%d: unknown command\n", path, n);
+            fclose(f);
+            return false;
+        }
+        ev->kind = (event_kind_t)kind;
+        int nargs = 0;
+        while ((tok = strtok(NULL, " \t\r\n")) != NULL) {
+            if (ev->kind == EV_KEY || ev->kind == EV_HOST) {
+                if (ev->count < MAX_EVENT_BYTES)
+                    ev->bytes[ev->count++] = (uint8_t)strtoul(tok, NULL, 16);
+            } else if (nargs < 3) {
+                const int base = ev->kind == EV_JOY && nargs == 1 ? 16 : 0;
+                ev->args[nargs++] = (int)strtol(tok, NULL, base);
+            }
+        }
+        if (ev->kind == EV_JOY && nargs < 2)
+            ev->args[1] = 0x3f;
+        g_event_count++;
+    }
+    fclose(f);
+    return true;
+}
+
+static void inject(sim_t *sim, event_t *ev)
+{
+    ev->injected = true;
+    switch (ev->kind) {
+    case EV_KEY:
+        ps2_device_send(&sim->keyboard, ev->bytes, ev->count);
+        break;
+    case EV_MOUSE:
+        ps2_device_move(&sim->mouse, ev->args[0], ev->args[1], (uint8_t)ev->args[2]);
+        break;
+    case EV_JOY:
+        sim_set_joystick(sim, ev->args[0], (uint8_t)ev->args[1]);
+        ev->delivered = true;
+        ev->delivered_cycle = sim->avr->cycle;
+        break;
+    case EV_HOST:
+        for (unsigned i = 0; i < ev->count; i++)
+            sim_uart_send(sim, ev->bytes[i]);
+        ev->delivered = true;
+        ev->delivered_cycle = sim->avr->cycle;
+        break;
+    default:
+        break;
+    }
+}
+
+// A PS/2 event is delivered once its device has clocked out everything.
+static void check_deliveries(sim_t *sim)
+{
+    for (unsigned i = 0; i < g_event_count; i++) {
+        event_t *ev = &g_events[i];
+        if (!ev->injected || ev->delivered)
+            continue;
+        const ps2_device_t *dev = ev->kind == EV_KEY ? &sim->keyboard : &sim->mouse;
+        if ((ev->kind == EV_KEY || ev->kind == EV_MOUSE) && ps2_device_idle(dev)) {
+            ev->delivered = true;
+            ev->delivered_cycle = dev->last_sent_cycle > ev->cycle ? dev->last_sent_cycle : ev->cycle;
+        }
+    }
+}
+
+// Index of the first UART byte at or after 'cycle', or uart_count.
+static unsigned first_output_after(const sim_t *sim, const avr_cycle_count_t cycle)
+{
+    unsigned lo = 0, hi = sim->uart_count;
+    while (lo < hi) {
+        const unsigned mid = (lo + hi) / 2;
+        if (sim->uart[mid].cycle < cycle)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+typedef struct {
+    unsigned long count;
+    double min, max, sum;
+} latency_t;
+
+static void add_latency(latency_t *l, const double ms)
+{
+    if (l->count == 0 || ms < l->min)
+        l->min = ms;
+    if (l->count == 0 || ms > l->max)
+        l->max = ms;
+    l->sum += ms;
+    l->count++;
+}
+
+int main(int argc, char **argv)
+{
+    bool verbose = false;
+    int arg = 1;
+    if (arg < argc && strcmp(argv[arg], "-v") == 0) {
+        verbose = true;
+        arg++;
+    }
+    if (argc - arg != 2) {
+        fprintf(stderr, "usage: %s [-v] ikbd.elf script\n", argv[0]);
+        return 2;
+    }
+    if (!parse_script(argv[arg + 1]))
+        return 1;
+
+    sim_t sim;
+    if (!sim_init(&sim, argv[arg]))
+        return 1;
+
+    avr_cycle_count_t end = g_event_count ? g_events[g_event_count - 1].cycle + sim_ms_to_cycles(100)
+                                          : sim_ms_to_cycles(1000);
+    if (g_event_count && g_events[g_event_count - 1].kind == EV_END)
+        end = g_events[g_event_count - 1].cycle;
+
+    unsigned next = 0;
+    bool ok = true;
+    while (ok && sim.avr->cycle < end) {
+        avr_cycle_count_t until = sim.avr->cycle + sim_ms_to_cycles(SLICE_MS);
+        if (next < g_event_count && g_events[next].cycle < until)
+            until = g_events[next].cycle;
+        if (until > end)
+            until = end;
+        ok = sim_run_until(&sim, until);
+        while (next < g_event_count && g_events[next].cycle <= sim.avr->cycle)
+            inject(&sim, &g_events[next++]);
+        check_deliveries(&sim);
+    }
+    if (!ok)
+        fprintf(stderr, "CPU stopped at %.3f ms\n", sim_cycles_to_ms(sim.avr->cycle));
+
+    if (verbose) {
+        for (unsigned i = 0; i < sim.uart_count; i++)
+            printf("%12llu %10.3f ms  %02X\n", (unsigned long long)sim.uart[i].cycle,
+                   sim_cycles_to_ms(sim.uart[i].cycle), sim.uart[i].c);
+        printf("\n");
+    }
+
+    // Latency from the stimulus reaching the firmware (last PS/2 bit, pin
+    // change or UART byte) to the next byte handed to the USART.
+    latency_t wire[EV_KINDS] = { 0 }, firmware[EV_KINDS] = { 0 };
+    for (unsigned i = 0; i < g_event_count; i++) {
+        const event_t *ev = &g_events[i];
+        if (!ev->delivered)
+            continue;
+        const unsigned out = first_output_after(&sim, ev->delivered_cycle);
+        add_latency(&wire[ev->kind], sim_cycles_to_ms(ev->delivered_cycle - ev->cycle));
+        if (out == sim.uart_count)
+            continue;
+        const double ms = sim_cycles_to_ms(sim.uart[out].cycle - ev->delivered_cycle);
+        add_latency(&firmware[ev->kind], ms);
+        if (verbose)
+            printf("line %4d %-5s delivered %10.3f ms, output after %8.3f ms\n", ev->line, kind_names[ev->kind],
+                   sim_cycles_to_ms(ev->delivered_cycle), ms);
+    }
+
+    const double run_ms = sim_cycles_to_ms(sim.avr->cycle);
+    printf("simulated %.1f ms, %llu cycles at %d Hz\n\n", run_ms, (unsigned long long)sim.avr->cycle, SIM_F_CPU);
+
+    printf("%-6s %6s %10s %10s %10s   %10s %10s %10s\n", "event", "count", "wire min", "avg", "max", "fw min",
+           "avg", "max");
+    for (int k = 0; k < EV_END; k++) {
+        if (wire[k].count == 0)
+            continue;
+        printf("%-6s %6lu %10.3f %10.3f %10.3f   ", kind_names[k], wire[k].count, wire[k].min,
+               wire[k].sum / wire[k].count, wire[k].max);
+        if (firmware[k].count)
+            printf("%10.3f %10.3f %10.3f\n", firmware[k].min, firmware[k].sum / firmware[k].count, firmware[k].max);
+        else
+            printf("%10s %10s %10s\n", "-", "-", "-");
+    }
+    printf("(latencies in ms)\n\n");
+
+    printf("USART out: %u bytes, %.1f bytes/s\n", sim.uart_count, run_ms > 0 ? sim.uart_count * 1000.0 / run_ms : 0);
+    const ps2_device_t *devs[2] = { &sim.keyboard, &sim.mouse };
+    for (int i = 0; i < 2; i++)
+        printf("PS/2 %-8s: %lu frames sent, %lu aborted, %lu bytes received, %lu parity errors\n", devs[i]->name,
+               devs[i]->frames_sent, devs[i]->frames_aborted, devs[i]->bytes_received, devs[i]->parity_errors);
+    printf("\n");
+    sim_print_isr_report(&sim, stdout);
+
+    sim_free(&sim);
+    return ok ? 0 : 1;
+}
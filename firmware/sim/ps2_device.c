@@ -0,0 +1,357 @@
+// ps2_device.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#include "ps2_device.h"
+
+#include "avr_ioport.h"
+#include "sim_time.h"
+
+// ATmega328P port D registers, data space addresses.
+#define DDRD_ADDR 0x2A
+#define PORTD_ADDR 0x2B
+
+// How often an idle device looks at the lines.
+#define POLL_US 10
+
+enum {
+    ST_IDLE,
+    ST_INHIBITED,
+    ST_TX_DATA,     // clock high, about to put the next bit on data
+    ST_TX_HIGH,     // clock high, data valid, about to pull the clock low
+    ST_TX_LOW,      // clock low
+    ST_TX_GLITCH,   // clock briefly low in the middle of a high phase
+    ST_RX_HIGH,
+    ST_RX_LOW,
+    ST_RX_SAMPLE,
+};
+
+// The external pull-ups of port D, shared by every device on it.
+static uint8_t g_pull_mask, g_pull_value;
+
+static bool host_pulls_low(const ps2_device_t *dev, const uint8_t bit)
+{
+    const uint8_t m = 1 << bit;
+    return (dev->avr->data[DDRD_ADDR] & m) && !(dev->avr->data[PORTD_ADDR] & m);
+}
+
+static void drive_pin(ps2_device_t *dev, const uint8_t bit, avr_irq_t *irq, const bool level)
+{
+    const uint8_t m = 1 << bit;
+    g_pull_mask |= m;
+    g_pull_value = level ? (g_pull_value | m) : (g_pull_value & ~m);
+    avr_ioport_external_t ext = { .name = 'D', .mask = g_pull_mask, .value = g_pull_value };
+    avr_ioctl(dev->avr, AVR_IOCTL_IOPORT_SET_EXTERNAL('D'), &ext);
+    // While the firmware drives the pin, it wins.
+    if (!(dev->avr->data[DDRD_ADDR] & m))
+        avr_raise_irq(irq, level);
+}
+
+static void drive(ps2_device_t *dev, const bool clk, const bool data)
+{
+    if (clk != dev->clk_out) {
+        dev->clk_out = clk;
+        drive_pin(dev, dev->clk_bit, dev->clk_irq, clk);
+    }
+    if (data != dev->data_out) {
+        dev->data_out = data;
+        drive_pin(dev, dev->data_bit, dev->data_irq, data);
+    }
+}
+
+static avr_cycle_count_t us(const ps2_device_t *dev, const uint32_t t)
+{
+    return avr_usec_to_cycles(dev->avr, t);
+}
+
+// A clock phase of nominally t microseconds, with jitter.
+static avr_cycle_count_t phase(ps2_device_t *dev, const uint32_t t)
+{
+    if (dev->jitter_us == 0)
+        return us(dev, t);
+    dev->seed = dev->seed * 1103515245u + 12345u;
+    const int32_t j = (int32_t)((dev->seed >> 16) % (2 * dev->jitter_us + 1)) - (int32_t)dev->jitter_us;
+    const int32_t jittered = (int32_t)t + j;
+    return us(dev, jittered < 5 ? 5 : (uint32_t)jittered);
+}
+
+static void queue_byte_faulty(ps2_device_t *dev, const uint8_t c, const uint8_t faults)
+{
+    const unsigned i = (dev->tail + 1) & PS2_DEVICE_QUEUE_MASK;
+    if (i == dev->head)
+        return; // a real device would lose it too
+    dev->queue[dev->tail] = c;
+    dev->faults[dev->tail] = faults;
+    dev->tail = i;
+}
+
+static void queue_byte(ps2_device_t *dev, const uint8_t c)
+{
+    queue_byte_faulty(dev, c, 0);
+}
+
+static uint16_t make_frame(const uint8_t c)
+{
+    uint8_t parity = 1;
+    for (int i = 0; i < 8; i++)
+        parity ^= (c >> i) & 1;
+    // start (0), data LSB first, parity, stop (1)
+    return (uint16_t)((c << 1) | (parity << 9) | (1 << 10));
+}
+
+static void queue_packet(ps2_device_t *dev)
+{
+    int dx = dev->dx, dy = dev->dy;
+    uint8_t b0 = 0x08 | (dev->buttons & 0x07);
+    if (dx < -256 || dx > 255)
+        b0 |= 0x40, dx = dx < 0 ? -256 : 255;
+    if (dy < -256 || dy > 255)
+        b0 |= 0x80, dy = dy < 0 ? -256 : 255;
+    if (dx < 0)
+        b0 |= 0x10;
+    if (dy < 0)
+        b0 |= 0x20;
+    queue_byte(dev, b0);
+    queue_byte(dev, (uint8_t)dx);
+    queue_byte(dev, (uint8_t)dy);
+    dev->dx = dev->dy = 0;
+}
+
+static void reset_device(ps2_device_t *dev)
+{
+    dev->head = dev->tail = 0;
+    dev->pending_command = 0;
+    dev->streaming = false;
+    dev->remote = false;
+    dev->dx = dev->dy = 0;
+    queue_byte(dev, 0xfa);
+    queue_byte(dev, 0xaa);
+    if (dev->type == PS2_DEVICE_MOUSE)
+        queue_byte(dev, 0x00);
+}
+
+static void handle_byte(ps2_device_t *dev, const uint8_t c)
+{
+    dev->bytes_received++;
+
+    if (dev->pending_command) {
+        const uint8_t command = dev->pending_command;
+        dev->pending_command = 0;
+        queue_byte(dev, 0xfa);
+        if (dev->type == PS2_DEVICE_KEYBOARD && command == 0xf0 && c == 0x00)
+            queue_byte(dev, 0x02); // always report set 2
+        return;
+    }
+
+    if (c == 0xff) {
+        reset_device(dev);
+        return;
+    }
+    if (c == 0xee) {
+        queue_byte(dev, 0xee); // echo
+        return;
+    }
+    // Any command cancels bytes not sent yet.
+    dev->head = dev->tail;
+    queue_byte(dev, 0xfa);
+    if (c == 0xf2) {
+        if (dev->type == PS2_DEVICE_KEYBOARD) {
+            queue_byte(dev, 0xab);
+            queue_byte(dev, 0x83);
+        } else {
+            queue_byte(dev, 0x00);
+        }
+    } else if (dev->type == PS2_DEVICE_KEYBOARD) {
+        if (c == 0xed || c == 0xf3 || c == 0xf0)
+            dev->pending_command = c;
+    } else {
+        switch (c) {
+        case 0xf3: case 0xe8:
+            dev->pending_command = c;
+            break;
+        case 0xf4: dev->streaming = true; break;
+        case 0xf5: dev->streaming = false; break;
+        case 0xea: dev->remote = false; break;
+        case 0xf0: dev->remote = true; break;
+        case 0xeb: queue_packet(dev); break;
+        default: break;
+        }
+    }
+}
+
+static avr_cycle_count_t step(avr_t *avr, const avr_cycle_count_t when, void *param)
+{
+    ps2_device_t *dev = (ps2_device_t *)param;
+    const uint32_t h = dev->half_period_us;
+    (void)avr;
+
+    switch (dev->state) {
+    case ST_IDLE:
+        if (host_pulls_low(dev, dev->clk_bit)) {
+            dev->state = ST_INHIBITED;
+            break;
+        }
+        if (dev->head != dev->tail && when - dev->idle_since >= us(dev, dev->response_delay_us)) {
+            dev->frame = make_frame(dev->queue[dev->head]);
+            dev->fault = dev->faults[dev->head];
+            if (dev->fault)
+                dev->frames_faulty++;
+            if (dev->fault & PS2_FAULT_PARITY)
+                dev->frame ^= 1 << 9;
+            dev->bit = 0;
+            drive(dev, true, false); // start bit
+            dev->state = ST_TX_HIGH;
+            return when + phase(dev, h / 2);
+        }
+        break;
+
+    case ST_INHIBITED:
+        if (!host_pulls_low(dev, dev->clk_bit)) {
+            if (host_pulls_low(dev, dev->data_bit)) {
+                // Request to send: clock the byte in.
+                dev->bit = 0;
+                dev->rx_data = 0;
+                dev->rx_parity = 0;
+                dev->state = ST_RX_HIGH;
+                return when + us(dev, h / 2);
+            }
+            dev->state = ST_IDLE;
+            dev->idle_since = when;
+        }
+        break;
+
+    case ST_TX_DATA:
+    case ST_TX_HIGH:
+        if (host_pulls_low(dev, dev->clk_bit)) {
+            // The host took the bus: abort, the byte is sent again later.
+            drive(dev, true, true);
+            dev->frames_aborted++;
+            dev->state = ST_INHIBITED;
+            break;
+        }
+        if (dev->state == ST_TX_DATA) {
+            if ((dev->fault & PS2_FAULT_GLITCH) && dev->bit == dev->glitch_bit) {
+                dev->fault &= ~PS2_FAULT_GLITCH;
+                drive(dev, false, dev->data_out);
+                dev->state = ST_TX_GLITCH;
+                return when + us(dev, dev->glitch_us);
+            }
+            drive(dev, true, (dev->frame >> dev->bit) & 1);
+            dev->state = ST_TX_HIGH;
+            return when + phase(dev, h / 2);
+        }
+        drive(dev, false, dev->data_out);
+        dev->state = ST_TX_LOW;
+        return when + phase(dev, h);
+
+    case ST_TX_GLITCH:
+        drive(dev, true, dev->data_out);
+        dev->state = ST_TX_DATA;
+        return when + us(dev, dev->glitch_us);
+
+    case ST_TX_LOW:
+        drive(dev, true, dev->data_out);
+        dev->bit++;
+        if (dev->bit == 11 || ((dev->fault & PS2_FAULT_TRUNCATE) && dev->bit == dev->truncate_bits)) {
+            // A truncated frame is lost for good, like a device unplugged mid byte.
+            dev->head = (dev->head + 1) & PS2_DEVICE_QUEUE_MASK;
+            dev->frames_sent++;
+            dev->last_sent_cycle = when;
+            drive(dev, true, true);
+            dev->state = ST_IDLE;
+            dev->idle_since = when;
+            break;
+        }
+        dev->state = ST_TX_DATA;
+        return when + phase(dev, h / 2);
+
+    case ST_RX_HIGH:
+        if (host_pulls_low(dev, dev->clk_bit) && dev->bit < 11) {
+            drive(dev, true, true);
+            dev->state = ST_INHIBITED;
+            break;
+        }
+        drive(dev, false, dev->data_out);
+        dev->state = ST_RX_LOW;
+        return when + phase(dev, h);
+
+    case ST_RX_LOW:
+        drive(dev, true, dev->data_out);
+        dev->bit++;
+        dev->state = ST_RX_SAMPLE;
+        return when + phase(dev, h / 2);
+
+    case ST_RX_SAMPLE: {
+        const uint8_t level = !host_pulls_low(dev, dev->data_bit);
+        if (dev->bit <= 8) {
+            dev->rx_data |= level << (dev->bit - 1);
+            dev->rx_parity ^= level;
+        } else if (dev->bit == 9) {
+            dev->rx_parity ^= level;
+        } else if (dev->bit == 10) {
+            drive(dev, true, false); // acknowledge on the next clock
+        } else {
+            drive(dev, true, true);
+            dev->state = ST_IDLE;
+            dev->idle_since = when;
+            if (dev->rx_parity != 1) {
+                dev->parity_errors++;
+                queue_byte(dev, 0xfe);
+            } else {
+                handle_byte(dev, dev->rx_data);
+            }
+            break;
+        }
+        dev->state = ST_RX_HIGH;
+        return when + phase(dev, h / 2);
+    }
+    }
+    return when + us(dev, POLL_US);
+}
+
+void ps2_device_init(ps2_device_t *dev, avr_t *avr, const ps2_device_type_t type, const int clk_pin,
+                     const int data_pin)
+{
+    *dev = (ps2_device_t){ 0 };
+    dev->avr = avr;
+    dev->type = type;
+    dev->name = type == PS2_DEVICE_KEYBOARD ? "keyboard" : "mouse";
+    dev->clk_bit = clk_pin;
+    dev->data_bit = data_pin;
+    dev->clk_irq = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), clk_pin);
+    dev->data_irq = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), data_pin);
+    dev->half_period_us = 40;       // 12.5 kHz
+    dev->response_delay_us = 500;
+    dev->seed = clk_pin;
+    dev->truncate_bits = 6;
+    dev->glitch_bit = 4;
+    dev->glitch_us = 2;
+    dev->clk_out = dev->data_out = false;
+    drive(dev, true, true);
+    avr_cycle_timer_register_usec(avr, POLL_US, step, dev);
+}
+
+void ps2_device_send(ps2_device_t *dev, const uint8_t *data, const unsigned count)
+{
+    for (unsigned i = 0; i < count; i++)
+        queue_byte(dev, data[i]);
+}
+
+void ps2_device_send_faulty(ps2_device_t *dev, const uint8_t c, const unsigned faults)
+{
+    queue_byte_faulty(dev, c, (uint8_t)faults);
+}
+
+void ps2_device_move(ps2_device_t *dev, const int dx, const int dy, const uint8_t buttons)
+{
+    dev->dx += dx;
+    dev->dy += dy;
+    dev->buttons = buttons;
+    if (dev->streaming && !dev->remote)
+        queue_packet(dev);
+}
+
+bool ps2_device_idle(const ps2_device_t *dev)
+{
+    return dev->head == dev->tail && (dev->state == ST_IDLE || dev->state == ST_INHIBITED);
+}
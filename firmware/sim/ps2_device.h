@@ -0,0 +1,99 @@
+// ps2_device.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// Model of a PS/2 keyboard or mouse attached to two simulated AVR pins.
+// Both lines are open collector: the level seen by the firmware is the AND
+// of what the device and the firmware (DDR/PORT) drive. The device clocks
+// out queued bytes, backs off while the host inhibits the clock, clocks in
+// host-to-device bytes and answers commands like a real device would.
+
+#ifndef PS2_DEVICE_H
+#define PS2_DEVICE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sim_avr.h"
+
+#define PS2_DEVICE_QUEUE_SIZE 256
+#define PS2_DEVICE_QUEUE_MASK (PS2_DEVICE_QUEUE_SIZE - 1)
+
+typedef enum {
+    PS2_DEVICE_KEYBOARD,
+    PS2_DEVICE_MOUSE,
+} ps2_device_type_t;
+
+// Ways to damage a device-to-host frame.
+enum {
+    PS2_FAULT_PARITY = 1 << 0,      // wrong parity bit
+    PS2_FAULT_TRUNCATE = 1 << 1,    // stop clocking after truncate_bits bits
+    PS2_FAULT_GLITCH = 1 << 2,      // extra short clock pulse at glitch_bit
+};
+
+typedef struct ps2_device {
+    avr_t *avr;
+    ps2_device_type_t type;
+    const char *name;
+    // Both pins are on port D (Arduino pins 0-7).
+    uint8_t clk_bit, data_bit;
+    avr_irq_t *clk_irq, *data_irq;
+
+    // Released (true) or pulled low (false) by the device.
+    bool clk_out, data_out;
+
+    // Bytes waiting to be clocked out, oldest first.
+    uint8_t queue[PS2_DEVICE_QUEUE_SIZE];
+    uint8_t faults[PS2_DEVICE_QUEUE_SIZE];
+    unsigned head, tail;
+
+    // Clock half period and response delay.
+    uint32_t half_period_us;
+    uint32_t response_delay_us;
+    // Each clock phase is off by up to this much, at random.
+    uint32_t jitter_us;
+    uint32_t seed;
+    // Fault parameters.
+    uint8_t truncate_bits;
+    uint8_t glitch_bit;
+    uint32_t glitch_us;
+
+    int state;
+    int bit;
+    uint16_t frame;
+    uint8_t fault;
+    uint8_t rx_data, rx_parity;
+    uint8_t pending_command;     // command waiting for its argument, or 0
+    avr_cycle_count_t idle_since;
+
+    // Mouse state.
+    bool streaming, remote;
+    int16_t dx, dy;
+    uint8_t buttons;
+
+    // Statistics.
+    unsigned long frames_sent;
+    unsigned long frames_aborted;
+    unsigned long frames_faulty;
+    unsigned long bytes_received;
+    unsigned long parity_errors;
+    // Cycle at which the last queued byte finished clocking out.
+    avr_cycle_count_t last_sent_cycle;
+} ps2_device_t;
+
+void ps2_device_init(ps2_device_t *dev, avr_t *avr, ps2_device_type_t type, int clk_pin, int data_pin);
+
+// Queue raw bytes, e.g. scan codes, to be sent to the host.
+void ps2_device_send(ps2_device_t *dev, const uint8_t *data, unsigned count);
+
+// Queue one byte, damaged as per the PS2_FAULT_xxx flags.
+void ps2_device_send_faulty(ps2_device_t *dev, uint8_t c, unsigned faults);
+
+// Mouse movement: sent as a packet when streaming, accumulated otherwise
+// until the host asks for it with 0xEB.
+void ps2_device_move(ps2_device_t *dev, int dx, int dy, uint8_t buttons);
+
+// True when nothing is queued or being transferred.
+bool ps2_device_idle(const ps2_device_t *dev);
+
+#endif // PS2_DEVICE_H
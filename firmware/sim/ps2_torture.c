@@ -0,0 +1,256 @@
+// ps2_torture.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// Feeds the firmware's PS/2 decoders with clean and damaged device-to-host
+// waveforms on simavr and reports how well they hold up: decoded key
+// accuracy, keys lost after a damaged frame, mouse motion accuracy and
+// interrupt load.
+//
+// Usage: ps2_torture [-n keys] [-s seed] ikbd.elf
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ikbd_packet.h"
+#include "sim.h"
+
+// Time left for the firmware to reset both devices.
+#define BOOT_MS 300
+// Time between key strokes, and between mouse packets (200 samples/s).
+#define KEY_INTERVAL_MS 8
+#define MOUSE_INTERVAL_MS 5
+// How far ahead in the output to look for an expected key.
+#define MATCH_WINDOW 6
+
+typedef struct {
+    const char *name;
+    uint32_t half_period_us;
+    uint32_t jitter_us;
+    unsigned fault_percent;
+    unsigned faults;            // PS2_FAULT_xxx to pick from
+    bool mouse;                 // stream mouse packets at the same time
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    { "10 kHz", 50, 0, 0, 0, false },
+    { "16.7 kHz", 30, 0, 0, 0, false },
+    { "16.7 kHz jitter", 30, 8, 0, 0, false },
+    { "both ports", 30, 0, 0, 0, true },
+    { "bad parity 5%", 40, 0, 5, PS2_FAULT_PARITY, false },
+    { "truncated 5%", 40, 0, 5, PS2_FAULT_TRUNCATE, false },
+    { "glitches 5%", 40, 0, 5, PS2_FAULT_GLITCH, false },
+    { "everything", 30, 8, 5, PS2_FAULT_PARITY | PS2_FAULT_TRUNCATE | PS2_FAULT_GLITCH, true },
+};
+
+// Set 2 make codes of A to P and the matching Atari ST scan codes.
+static const uint8_t set2_codes[] = { 0x1c, 0x32, 0x21, 0x23, 0x24, 0x2b, 0x34, 0x33,
+                                      0x43, 0x3b, 0x42, 0x4b, 0x3a, 0x31, 0x44, 0x4d };
+static const uint8_t st_codes[] = { 0x1e, 0x30, 0x2e, 0x20, 0x12, 0x21, 0x22, 0x23,
+                                    0x17, 0x24, 0x25, 0x26, 0x32, 0x31, 0x18, 0x19 };
+#define NUM_KEYS (sizeof(set2_codes) / sizeof(set2_codes[0]))
+
+static uint32_t g_seed;
+
+static uint32_t next_random(void)
+{
+    g_seed = g_seed * 1103515245u + 12345u;
+    return g_seed >> 16;
+}
+
+static unsigned pick_faults(const scenario_t *sc)
+{
+    if (sc->fault_percent == 0 || next_random() % 100 >= sc->fault_percent)
+        return 0;
+    unsigned f;
+    do
+        f = 1u << (next_random() % 3);
+    while (!(f & sc->faults));
+    return f;
+}
+
+typedef struct {
+    avr_cycle_count_t cycle;
+    uint8_t key;
+    bool faulty;
+} keystroke_t;
+
+typedef struct {
+    avr_cycle_count_t cycle;
+    uint8_t code;
+} key_event_t;
+
+static void run_scenario(const char *elf, const scenario_t *sc, const unsigned num_keys)
+{
+    sim_t sim;
+    if (!sim_init(&sim, elf))
+        exit(1);
+    ps2_device_t *devs[2] = { &sim.keyboard, &sim.mouse };
+    for (int i = 0; i < 2; i++) {
+        devs[i]->half_period_us = sc->half_period_us;
+        devs[i]->jitter_us = sc->jitter_us;
+        devs[i]->response_delay_us = 100;
+    }
+
+    keystroke_t *strokes = calloc(num_keys, sizeof(*strokes));
+    long mouse_sent = 0;
+
+    bool ok = sim_run_until(&sim, sim_ms_to_cycles(BOOT_MS));
+    const unsigned boot_output = sim.uart_count;
+    const avr_cycle_count_t start = sim.avr->cycle;
+    const avr_cycle_count_t key_step = sim_ms_to_cycles(KEY_INTERVAL_MS);
+    const avr_cycle_count_t mouse_step = sim_ms_to_cycles(MOUSE_INTERVAL_MS);
+    const avr_cycle_count_t stop = start + key_step * num_keys;
+    avr_cycle_count_t next_key = start, next_mouse = start;
+    unsigned k = 0;
+
+    while (ok && sim.avr->cycle < stop) {
+        avr_cycle_count_t until = next_key;
+        if (sc->mouse && next_mouse < until)
+            until = next_mouse;
+        ok = sim_run_until(&sim, until);
+        if (sim.avr->cycle >= next_key && k < num_keys) {
+            // Make and break of the next key, damaging any of the three frames.
+            const uint8_t code = set2_codes[k % NUM_KEYS];
+            const unsigned f0 = pick_faults(sc), f1 = pick_faults(sc), f2 = pick_faults(sc);
+            ps2_device_send_faulty(&sim.keyboard, code, f0);
+            ps2_device_send_faulty(&sim.keyboard, 0xf0, f1);
+            ps2_device_send_faulty(&sim.keyboard, code, f2);
+            strokes[k].cycle = sim.avr->cycle;
+            strokes[k].key = k % NUM_KEYS;
+            strokes[k].faulty = f0 || f1 || f2;
+            k++;
+            next_key += key_step;
+        }
+        if (sc->mouse && sim.avr->cycle >= next_mouse) {
+            if (sim.mouse.streaming) {
+                // Diagonal motion, one count along each axis.
+                ps2_device_send_faulty(&sim.mouse, 0x08, pick_faults(sc));
+                ps2_device_send_faulty(&sim.mouse, 0x01, pick_faults(sc));
+                ps2_device_send_faulty(&sim.mouse, 0x01, pick_faults(sc));
+                mouse_sent += 2;
+            }
+            next_mouse += mouse_step;
+        }
+    }
+    if (ok)
+        ok = sim_run_until(&sim, sim.avr->cycle + sim_ms_to_cycles(300));
+
+    // Split the IKBD output into key codes and mouse motion.
+    key_event_t *keys = calloc(sim.uart_count + 1, sizeof(*keys));
+    unsigned num_out = 0;
+    long out_dx = 0, out_dy = 0;
+    for (unsigned i = boot_output; i < sim.uart_count; i += ikbd_packet_length(sim.uart[i].c)) {
+        const uint8_t c = sim.uart[i].c;
+        if (c >= 0xf8 && c <= 0xfb && i + 2 < sim.uart_count) {
+            out_dx += (int8_t)sim.uart[i + 1].c;
+            out_dy += (int8_t)sim.uart[i + 2].c;
+        } else if (ikbd_packet_length(c) == 1) {
+            keys[num_out].cycle = sim.uart[i].cycle;
+            keys[num_out].code = c;
+            num_out++;
+        }
+    }
+
+    // Match each key stroke's make and break codes, in order, allowing for
+    // missing and spurious codes in between.
+    unsigned pos = 0, clean = 0, clean_ok = 0, faulty = 0, faulty_ok = 0, matched = 0;
+    bool *decoded = calloc(num_keys, sizeof(*decoded));
+    for (unsigned i = 0; i < k; i++) {
+        const uint8_t make = st_codes[strokes[i].key];
+        unsigned p = pos;
+        while (p < num_out && p < pos + MATCH_WINDOW && keys[p].code != make)
+            p++;
+        if (p < num_out && p < pos + MATCH_WINDOW) {
+            unsigned q = p + 1;
+            while (q < num_out && q < p + 1 + MATCH_WINDOW && keys[q].code != (make | 0x80))
+                q++;
+            if (q < num_out && q < p + 1 + MATCH_WINDOW) {
+                decoded[i] = true;
+                matched += 2;
+                pos = q + 1;
+            }
+        }
+        if (strokes[i].faulty) {
+            faulty++;
+            faulty_ok += decoded[i];
+        } else {
+            clean++;
+            clean_ok += decoded[i];
+        }
+    }
+
+    // After each damaged key stroke: clean key strokes lost, and time until
+    // a key stroke gets through again.
+    unsigned recoveries = 0, lost_total = 0, lost_max = 0;
+    double recovery_sum = 0, recovery_max = 0;
+    for (unsigned i = 0; i < k; i++) {
+        if (!strokes[i].faulty)
+            continue;
+        unsigned lost = 0, j = i + 1;
+        while (j < k && (strokes[j].faulty || !decoded[j])) {
+            lost += !strokes[j].faulty;
+            j++;
+        }
+        if (j == k)
+            continue;
+        const double ms = sim_cycles_to_ms(strokes[j].cycle - strokes[i].cycle);
+        recoveries++;
+        lost_total += lost;
+        if (lost > lost_max)
+            lost_max = lost;
+        recovery_sum += ms;
+        if (ms > recovery_max)
+            recovery_max = ms;
+    }
+
+    const avr_cycle_count_t int_max = sim.vectors[1].max_cycles > sim.vectors[2].max_cycles ? sim.vectors[1].max_cycles
+                                                                                       : sim.vectors[2].max_cycles;
+    const double int_load = 100.0 * (sim.vectors[1].cycles + sim.vectors[2].cycles) / sim.avr->cycle;
+
+    printf("%-16s %7.2f%% %7u/%-5u %5u %6.1f %6u %8.1f %8.1f",
+           sc->name, clean ? 100.0 * clean_ok / clean : 0.0, faulty_ok, faulty, num_out - matched,
+           recoveries ? (double)lost_total / recoveries : 0.0, lost_max,
+           recoveries ? recovery_sum / recoveries : 0.0, recovery_max);
+    if (sc->mouse)
+        printf(" %6.1f%%", mouse_sent ? 100.0 * (labs(out_dx) + labs(out_dy)) / mouse_sent : 0.0);
+    else
+        printf(" %7s", "-");
+    printf(" %6.2f%% %6llu%s\n", int_load, (unsigned long long)int_max, ok ? "" : "  (CPU stopped)");
+
+    free(decoded);
+    free(keys);
+    free(strokes);
+    sim_free(&sim);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned num_keys = 500;
+    g_seed = 1;
+    int arg = 1;
+    while (arg + 1 < argc && argv[arg][0] == '-') {
+        if (strcmp(argv[arg], "-n") == 0)
+            num_keys = (unsigned)strtoul(argv[arg + 1], NULL, 0);
+        else if (strcmp(argv[arg], "-s") == 0)
+            g_seed = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+        else
+            break;
+        arg += 2;
+    }
+    if (argc - arg != 1 || num_keys == 0) {
+        fprintf(stderr, "usage: %s [-n keys] [-s seed] ikbd.elf\n", argv[0]);
+        return 2;
+    }
+
+    printf("%-16s %8s %13s %5s %6s %6s %8s %8s %7s %7s %6s\n", "scenario", "clean ok", "damaged ok", "spur",
+           "lost", "max", "recov ms", "max ms", "mouse", "INT load", "max");
+    for (unsigned i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+        run_scenario(argv[arg], &scenarios[i], num_keys);
+    printf("\nclean ok: undamaged key strokes decoded; damaged ok: damaged key strokes decoded anyway;\n"
+           "spur: unexpected key codes; lost: undamaged key strokes lost after a damaged one (mean, max);\n"
+           "recov: time from a damaged key stroke to the next one decoded; mouse: motion reported/sent;\n"
+           "INT load: share of CPU time in the PS/2 clock interrupts, max: longest one in cycles.\n");
+    return 0;
+}
@@ -0,0 +1,185 @@
+// sim.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#include "sim.h"
+
+#include <stdlib.h>
+
+#include "avr_ioport.h"
+#include "avr_uart.h"
+#include "sim_elf.h"
+
+#include "config.h"
+
+static const char *const vector_names[SIM_MAX_VECTORS] = {
+    [1] = "INT0",
+    [2] = "INT1",
+    [3] = "PCINT0",
+    [4] = "PCINT1",
+    [5] = "PCINT2",
+    [6] = "WDT",
+    [7] = "TIMER2_COMPA",
+    [8] = "TIMER2_COMPB",
+    [9] = "TIMER2_OVF",
+    [10] = "TIMER1_CAPT",
+    [11] = "TIMER1_COMPA",
+    [12] = "TIMER1_COMPB",
+    [13] = "TIMER1_OVF",
+    [14] = "TIMER0_COMPA",
+    [15] = "TIMER0_COMPB",
+    [16] = "TIMER0_OVF",
+    [17] = "SPI_STC",
+    [18] = "USART_RX",
+    [19] = "USART_UDRE",
+    [20] = "USART_TX",
+    [21] = "ADC",
+    [22] = "EE_READY",
+    [23] = "ANALOG_COMP",
+    [24] = "TWI",
+    [25] = "SPM_READY",
+};
+
+static void uart_output(struct avr_irq_t *irq, const uint32_t value, void *param)
+{
+    sim_t *sim = (sim_t *)param;
+    (void)irq;
+    if (sim->uart_count == sim->uart_capacity) {
+        sim->uart_capacity = sim->uart_capacity ? sim->uart_capacity * 2 : 4096;
+        sim->uart = realloc(sim->uart, sim->uart_capacity * sizeof(*sim->uart));
+        if (!sim->uart)
+            abort();
+    }
+    // Start, 8 data bits and stop, after the byte being shifted out.
+    const avr_cycle_count_t now = sim->avr->cycle;
+    const avr_cycle_count_t start = now > sim->uart_busy_until ? now : sim->uart_busy_until;
+    sim->uart_busy_until = start + 10ull * SIM_F_CPU / SERIAL_BAUD_RATE;
+    sim->uart[sim->uart_count].cycle = now;
+    sim->uart[sim->uart_count].stop = sim->uart_busy_until;
+    sim->uart[sim->uart_count].c = (uint8_t)value;
+    sim->uart_count++;
+}
+
+bool sim_init(sim_t *sim, const char *elf_path)
+{
+    *sim = (sim_t){ 0 };
+
+    elf_firmware_t f = { 0 };
+    if (elf_read_firmware(elf_path, &f) != 0) {
+        fprintf(stderr, "%s: can't load firmware\n", elf_path);
+        return false;
+    }
+    f.frequency = SIM_F_CPU;
+    sim->avr = avr_make_mcu_by_name(f.mmcu[0] ? f.mmcu : "atmega328p");
+    if (!sim->avr) {
+        fprintf(stderr, "%s: unknown MCU\n", elf_path);
+        return false;
+    }
+    avr_init(sim->avr);
+    avr_load_firmware(sim->avr, &f);
+    sim->avr->frequency = SIM_F_CPU;
+
+    // Capture the output ourselves rather than echoing it to stdout.
+    uint32_t flags = 0;
+    avr_ioctl(sim->avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+    flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(sim->avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+    avr_irq_register_notify(avr_io_getirq(sim->avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), uart_output,
+                            sim);
+
+    ps2_device_init(&sim->keyboard, sim->avr, PS2_DEVICE_KEYBOARD, PS2_KEYBOARD_CLK_PIN, PS2_KEYBOARD_DATA_PIN);
+    ps2_device_init(&sim->mouse, sim->avr, PS2_DEVICE_MOUSE, PS2_MOUSE_CLK_PIN, PS2_MOUSE_DATA_PIN);
+    sim_set_joystick(sim, 0, 0x3f);
+    sim_set_joystick(sim, 1, 0x3f);
+    return true;
+}
+
+void sim_free(sim_t *sim)
+{
+    avr_terminate(sim->avr);
+    sim->avr = NULL;
+    free(sim->uart);
+    sim->uart = NULL;
+    sim->uart_count = sim->uart_capacity = 0;
+}
+
+static void account(sim_t *sim, const avr_cycle_count_t before)
+{
+    const avr_cycle_count_t now = sim->avr->cycle;
+    const uint8_t depth = sim->avr->interrupts.running_ptr;
+
+    // Interrupts are entered before the instruction runs, so its cycles
+    // belong to the new vector.
+    while (sim->depth < depth && sim->depth < SIM_MAX_DEPTH) {
+        const int v = sim->avr->interrupts.running[sim->depth]->vector;
+        sim->depth_vector[sim->depth] = v < SIM_MAX_VECTORS ? v : 0;
+        sim->depth_entry[sim->depth] = before;
+        sim->vectors[sim->depth_vector[sim->depth]].entries++;
+        sim->depth++;
+    }
+    // A reti belongs to the vector it returns from.
+    if (sim->depth > 0) {
+        sim->vectors[sim->depth_vector[sim->depth - 1]].cycles += now - before;
+        sim->isr_cycles += now - before;
+    }
+    while (sim->depth > depth) {
+        sim->depth--;
+        sim_vector_stats_t *s = &sim->vectors[sim->depth_vector[sim->depth]];
+        const avr_cycle_count_t length = now - sim->depth_entry[sim->depth];
+        if (length > s->max_cycles)
+            s->max_cycles = length;
+    }
+}
+
+bool sim_run_until(sim_t *sim, const avr_cycle_count_t cycle)
+{
+    while (sim->avr->cycle < cycle) {
+        const avr_cycle_count_t before = sim->avr->cycle;
+        const int state = avr_run(sim->avr);
+        if (state == cpu_Done || state == cpu_Crashed)
+            return false;
+        account(sim, before);
+    }
+    return true;
+}
+
+avr_cycle_count_t sim_ms_to_cycles(const double ms)
+{
+    return (avr_cycle_count_t)(ms * (SIM_F_CPU / 1000.0));
+}
+
+double sim_cycles_to_ms(const avr_cycle_count_t cycles)
+{
+    return cycles / (SIM_F_CPU / 1000.0);
+}
+
+void sim_uart_send(sim_t *sim, const uint8_t c)
+{
+    avr_raise_irq(avr_io_getirq(sim->avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT), c);
+}
+
+void sim_set_joystick(sim_t *sim, const int port, const uint8_t value)
+{
+    // Port 0 is on PB5:0, port 1 on PC5:0, with the firmware's pull-ups.
+    const char name = port == 0 ? 'B' : 'C';
+    avr_ioport_external_t ext = { .name = name, .mask = 0x3f, .value = value & 0x3f };
+    avr_ioctl(sim->avr, AVR_IOCTL_IOPORT_SET_EXTERNAL(name), &ext);
+    for (int i = 0; i < 6; i++)
+        avr_raise_irq(avr_io_getirq(sim->avr, AVR_IOCTL_IOPORT_GETIRQ(name), i), (value >> i) & 1);
+}
+
+void sim_print_isr_report(const sim_t *sim, FILE *out)
+{
+    const avr_cycle_count_t total = sim->avr->cycle;
+    fprintf(out, "%-14s %10s %12s %10s %10s %7s\n", "vector", "entries", "cycles", "avg", "max", "load");
+    for (int v = 0; v < SIM_MAX_VECTORS; v++) {
+        const sim_vector_stats_t *s = &sim->vectors[v];
+        if (s->entries == 0)
+            continue;
+        fprintf(out, "%-14s %10lu %12llu %10.1f %10llu %6.2f%%\n", vector_names[v] ? vector_names[v] : "?",
+                s->entries, (unsigned long long)s->cycles, (double)s->cycles / s->entries,
+                (unsigned long long)s->max_cycles, total ? 100.0 * s->cycles / total : 0.0);
+    }
+    fprintf(out, "%-14s %10s %12llu %10s %10s %6.2f%%\n", "all", "", (unsigned long long)sim->isr_cycles, "", "",
+            total ? 100.0 * sim->isr_cycles / total : 0.0);
+}
@@ -0,0 +1,70 @@
+// sim.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// Runs the real firmware ELF on simavr, with a PS/2 keyboard and mouse
+// attached, the joystick ports under control of the caller and the USART
+// output captured with cycle timestamps. Cycles spent in each interrupt
+// vector are accounted for as the simulation runs.
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ps2_device.h"
+#include "sim_avr.h"
+
+#define SIM_F_CPU 7372800
+#define SIM_MAX_VECTORS 32
+#define SIM_MAX_DEPTH 8
+
+typedef struct {
+    avr_cycle_count_t cycle;        // written to UDR0
+    avr_cycle_count_t stop;         // end of its stop bit on the wire
+    uint8_t c;
+} sim_uart_byte_t;
+
+typedef struct {
+    unsigned long entries;
+    avr_cycle_count_t cycles;       // exclusive of nested interrupts
+    avr_cycle_count_t max_cycles;   // longest single run, entry to reti
+} sim_vector_stats_t;
+
+typedef struct {
+    avr_t *avr;
+    ps2_device_t keyboard, mouse;
+
+    sim_uart_byte_t *uart;
+    unsigned uart_count, uart_capacity;
+    avr_cycle_count_t uart_busy_until;
+
+    sim_vector_stats_t vectors[SIM_MAX_VECTORS];
+    avr_cycle_count_t isr_cycles;
+    uint8_t depth;
+    int depth_vector[SIM_MAX_DEPTH];
+    avr_cycle_count_t depth_entry[SIM_MAX_DEPTH];
+} sim_t;
+
+// Load the firmware and attach the devices. Return false with a message
+// on stderr if the ELF can't be loaded.
+bool sim_init(sim_t *sim, const char *elf_path);
+void sim_free(sim_t *sim);
+
+// Run until the given cycle. Return false if the CPU stopped or crashed.
+bool sim_run_until(sim_t *sim, avr_cycle_count_t cycle);
+
+avr_cycle_count_t sim_ms_to_cycles(double ms);
+double sim_cycles_to_ms(avr_cycle_count_t cycles);
+
+// A byte from the Atari to the IKBD.
+void sim_uart_send(sim_t *sim, uint8_t c);
+
+// Raw joystick port value, bits 5:0 active low.
+void sim_set_joystick(sim_t *sim, int port, uint8_t value);
+
+void sim_print_isr_report(const sim_t *sim, FILE *out);
+
+#endif // SIM_H
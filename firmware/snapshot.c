@@ -0,0 +1,124 @@
+// snapshot.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#include "snapshot.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "crc16.h"
+#include "eeprom.h"
+#include "eeprom_map.h"
+#include "hal.h"
+
+// Size, data and a CRC of both, with a magic number telling a snapshot
+// from the random contents of RAM after power up.
+#define SNAPSHOT_MAGIC 0x4b53
+
+typedef struct {
+    uint16_t magic;
+    uint8_t size;
+    uint16_t crc;
+    // The EEPROM copy, from here on: the number of bytes of data stored,
+    // their CRC, big endian, then the data.
+    uint8_t stored;
+    uint8_t stored_crc[2];
+    uint8_t data[SNAPSHOT_MAX_SIZE];
+} snapshot_t;
+
+#define EEPROM_COPY_HEADER 3
+
+_Static_assert(offsetof(snapshot_t, data) == offsetof(snapshot_t, stored) + EEPROM_COPY_HEADER,
+               "the EEPROM copy of the snapshot isn't contiguous");
+
+#if SNAPSHOT_EEPROM && EEPROM_COPY_HEADER + SNAPSHOT_MAX_SIZE > EEPROM_SNAPSHOT_SIZE
+#error "snapshot doesn't fit its EEPROM region"
+#endif
+
+static snapshot_t g_snapshot HAL_NOINIT;
+
+#if SNAPSHOT_EEPROM
+// Next byte of the EEPROM copy to check, past the end when up to date.
+static uint8_t g_save_pos = 0xff;
+#endif
+
+static uint16_t snapshot_crc(const uint8_t size, const uint8_t *data)
+{
+    uint16_t crc = crc16_update(0xffff, size);
+    for (uint8_t i = 0; i < size; i++)
+        crc = crc16_update(crc, data[i]);
+    return crc;
+}
+
+static bool snapshot_valid(void)
+{
+    return g_snapshot.magic == SNAPSHOT_MAGIC && g_snapshot.size <= SNAPSHOT_MAX_SIZE &&
+           g_snapshot.stored <= g_snapshot.size && g_snapshot.crc == snapshot_crc(g_snapshot.size, g_snapshot.data);
+}
+
+void snapshot_save(const uint8_t *data, const uint8_t size, uint8_t stored)
+{
+    if (size > SNAPSHOT_MAX_SIZE ||
+        (snapshot_valid() && g_snapshot.size == size && memcmp(g_snapshot.data, data, size) == 0))
+        return;
+    if (stored > size)
+        stored = size;
+#if SNAPSHOT_EEPROM
+    // Only a change to the stored bytes needs the EEPROM copy updated.
+    if (!snapshot_valid() || g_snapshot.stored != stored || memcmp(g_snapshot.data, data, stored) != 0)
+        g_save_pos = 0;
+#endif
+    // Invalid while it changes, in case a reset hits in the middle.
+    g_snapshot.magic = 0;
+    g_snapshot.size = size;
+    memcpy(g_snapshot.data, data, size);
+    g_snapshot.crc = snapshot_crc(size, data);
+    g_snapshot.stored = stored;
+    const uint16_t stored_crc = snapshot_crc(stored, data);
+    g_snapshot.stored_crc[0] = stored_crc >> 8;
+    g_snapshot.stored_crc[1] = stored_crc & 0xff;
+    g_snapshot.magic = SNAPSHOT_MAGIC;
+}
+
+#if SNAPSHOT_EEPROM
+static bool restore_from_eeprom(const uint8_t size)
+{
+    const uint8_t stored = hal_eeprom_read(EEPROM_SNAPSHOT_ADDR);
+    if (stored > size || size > SNAPSHOT_MAX_SIZE)
+        return false;
+    const uint16_t crc = hal_eeprom_read(EEPROM_SNAPSHOT_ADDR + 1) << 8 | hal_eeprom_read(EEPROM_SNAPSHOT_ADDR + 2);
+    memset(g_snapshot.data, 0, size);
+    for (uint8_t i = 0; i < stored; i++)
+        g_snapshot.data[i] = hal_eeprom_read(EEPROM_SNAPSHOT_ADDR + EEPROM_COPY_HEADER + i);
+    if (crc != snapshot_crc(stored, g_snapshot.data))
+        return false;
+    g_snapshot.size = size;
+    g_snapshot.crc = snapshot_crc(size, g_snapshot.data);
+    g_snapshot.stored = stored;
+    g_snapshot.stored_crc[0] = crc >> 8;
+    g_snapshot.stored_crc[1] = crc & 0xff;
+    g_snapshot.magic = SNAPSHOT_MAGIC;
+    return true;
+}
+#endif
+
+bool snapshot_restore(uint8_t *data, const uint8_t size)
+{
+    bool valid = snapshot_valid();
+#if SNAPSHOT_EEPROM
+    if (!valid)
+        valid = restore_from_eeprom(size);
+#endif
+    if (!valid || g_snapshot.size != size)
+        return false;
+    memcpy(data, g_snapshot.data, size);
+    return true;
+}
+
+void snapshot_poll(void)
+{
+#if SNAPSHOT_EEPROM
+    eeprom_sync(EEPROM_SNAPSHOT_ADDR, &g_snapshot.stored, EEPROM_COPY_HEADER + g_snapshot.stored, &g_save_pos);
+#endif
+}
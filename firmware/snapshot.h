@@ -0,0 +1,39 @@
+// snapshot.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+
+// Keeps the IKBD state set up by the host (IKBD_MemorySnapShot_Capture)
+// across a reset of the MCU alone: a watchdog or brown-out reset, or the
+// reset button. The snapshot lives in RAM that the startup code doesn't
+// clear, and with SNAPSHOT_EEPROM also in EEPROM, for resets where the
+// RAM didn't survive.
+
+#define SNAPSHOT_MAX_SIZE 40
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Store a snapshot, if it differs from the last one. Only the first
+// 'stored' bytes go to the EEPROM copy: state that changes all the time,
+// such as the mouse position, would wear it out within hours.
+void snapshot_save(const uint8_t *data, uint8_t size, uint8_t stored);
+// Fetch the last snapshot. False if there is none of this size that checks
+// out. From the EEPROM copy, the bytes past the stored ones read as 0.
+bool snapshot_restore(uint8_t *data, uint8_t size);
+// Write the next changed byte of the EEPROM copy.
+void snapshot_poll(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SNAPSHOT_H
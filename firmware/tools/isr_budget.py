@@ -0,0 +1,342 @@
+#!/usr/bin/env python3
+# isr_budget.py
+# Copyright (c) 2025 Rob Gowin
+# SPDX-License-Identifier: MIT
+
+"""Static worst-case cycle count of each interrupt handler of the AVR build.
+
+Disassembles the linked ELF with avr-objdump, finds the handler of every
+used vector, and computes the longest path through it in CPU cycles,
+following calls, from the interrupt response to reti. Loops need a bound
+(--loop-bound) and indirect calls a list of targets (--indirect); anything
+the tool can't bound is an error rather than a guess.
+
+The PS/2 clock interrupts must be done in time for the next clock edge:
+the handler, plus the longest handler that may be running when the edge
+comes, plus any higher priority PS/2 handler, must fit in one PS/2 bit at
+the fastest clock devices use. The USART receive interrupt gets one byte
+time at the fastest rate the settings allow (SERIAL_BAUD_RATE_MAX) on the
+same terms. Exits with 1 when a budget is
+exceeded, 2 when a handler can't be analysed.
+
+Usage: isr_budget.py [options] ikbd.elf
+"""
+
+import argparse
+import re
+import subprocess
+import sys
+
+VECTOR_NAMES = {
+    1: "INT0", 2: "INT1", 3: "PCINT0", 4: "PCINT1", 5: "PCINT2", 6: "WDT",
+    7: "TIMER2_COMPA", 8: "TIMER2_COMPB", 9: "TIMER2_OVF", 10: "TIMER1_CAPT",
+    11: "TIMER1_COMPA", 12: "TIMER1_COMPB", 13: "TIMER1_OVF",
+    14: "TIMER0_COMPA", 15: "TIMER0_COMPB", 16: "TIMER0_OVF", 17: "SPI_STC",
+    18: "USART_RX", 19: "USART_UDRE", 20: "USART_TX", 21: "ADC",
+    22: "EE_READY", 23: "ANALOG_COMP", 24: "TWI", 25: "SPM_READY",
+}
+
+# Arduino pins of the external interrupts.
+INT_PINS = {2: "INT0", 3: "INT1"}
+
+# Interrupt response: push of PC and jump to the vector.
+RESPONSE_CYCLES = 4
+
+# Cycles of an ATmega328P (AVRe+) instruction, when it doesn't branch.
+CYCLES = {}
+for m in ("add adc sub subi sbc sbci and andi or ori eor com neg sbr cbr inc dec "
+          "tst clr ser mov movw ldi in out lsl lsr rol ror asr swap bset bclr bst "
+          "bld sec clc sen cln sez clz sei cli ses cls sev clv set clt seh clh "
+          "nop cp cpc cpi wdr sleep break").split():
+    CYCLES[m] = 1
+for m in ("adiw sbiw mul muls mulsu fmul fmuls fmulsu ld ldd lds st std sts "
+          "push pop sbi cbi rjmp ijmp").split():
+    CYCLES[m] = 2
+for m in "lpm elpm jmp rcall icall".split():
+    CYCLES[m] = 3
+for m in "call ret reti".split():
+    CYCLES[m] = 4
+BRANCHES = set(("brbs brbc breq brne brcs brcc brsh brlo brmi brpl brge brlt "
+                "brhs brhc brts brtc brvs brvc brie brid").split())
+SKIPS = set("cpse sbrc sbrs sbic sbis".split())
+
+FUNC_RE = re.compile(r"^([0-9a-f]+) <(.+)>:$")
+INSN_RE = re.compile(r"^\s+([0-9a-f]+):\t([0-9a-f ]+?)\s*\t(\S+)\s*(.*)$")
+TARGET_RE = re.compile(r";\s*0x([0-9a-f]+)")
+
+
+class AnalysisError(Exception):
+    pass
+
+
+class Insn:
+    def __init__(self, addr, size, mnemonic, operands):
+        self.addr = addr
+        self.size = size
+        self.mnemonic = mnemonic
+        self.operands = operands
+
+    def target(self):
+        # Relative operands come with the absolute address as a comment.
+        m = TARGET_RE.search(self.operands)
+        if m:
+            return int(m.group(1), 16)
+        return int(self.operands.split()[0].rstrip(","), 0)
+
+
+class Program:
+    def __init__(self, disassembly, loop_bounds, indirect):
+        self.loop_bounds = loop_bounds
+        self.indirect = indirect
+        self.insns = {}
+        self.funcs = {}     # start address -> name
+        self.func_of = {}   # instruction address -> function start
+        self.wcet_cache = {}
+        self.active = set()
+        current = None
+        for line in disassembly.splitlines():
+            m = FUNC_RE.match(line)
+            if m:
+                current = int(m.group(1), 16)
+                self.funcs[current] = m.group(2)
+                continue
+            m = INSN_RE.match(line)
+            if m and current is not None:
+                addr = int(m.group(1), 16)
+                size = len(m.group(2).split())
+                self.insns[addr] = Insn(addr, size, m.group(3), m.group(4))
+                self.func_of[addr] = current
+        self.by_name = {name: addr for addr, name in self.funcs.items()}
+
+    def body(self, start):
+        addrs = [a for a, f in self.func_of.items() if f == start]
+        return sorted(addrs)
+
+    def matching(self, table, name):
+        for pattern, value in table:
+            if re.search(pattern, name):
+                return value
+        return None
+
+    def wcet(self, start):
+        """Worst-case cycles from entering the function to its return."""
+        if start in self.wcet_cache:
+            return self.wcet_cache[start]
+        name = self.funcs.get(start)
+        if name is None:
+            raise AnalysisError("call to 0x%x, which is not the start of a function" % start)
+        if start in self.active:
+            raise AnalysisError("%s is recursive" % name)
+        self.active.add(start)
+        addrs = self.body(start)
+        best = self.region(name, addrs, addrs[0], addrs[-1], None)
+        self.active.discard(start)
+        self.wcet_cache[start] = best[start]
+        return best[start]
+
+    def callee_cost(self, name, insn):
+        """Cycles of what a call or tail call runs, and how it continues:
+        'return' to the next instruction, 'exit' from the function, or
+        'table' for a switch jump to anywhere further down."""
+        target = insn.target()
+        callee = self.funcs.get(target, "")
+        if callee.startswith("__tablejump"):
+            return self.straight_line(target), "table"
+        if insn.mnemonic in ("call", "rcall"):
+            return self.wcet(target), "return"
+        return self.wcet(target), "exit"
+
+    def straight_line(self, start):
+        # The libgcc table jump helpers run straight through to an ijmp.
+        cycles = 0
+        for a in self.body(start):
+            insn = self.insns[a]
+            cycles += CYCLES.get(insn.mnemonic, 0)
+            if insn.mnemonic in ("ijmp", "eijmp"):
+                return cycles
+        raise AnalysisError("%s does not end with an indirect jump" % self.funcs[start])
+
+    def indirect_cost(self, name, insn):
+        targets = self.matching(self.indirect, name)
+        if targets is None:
+            raise AnalysisError("%s+0x%x: %s with no --indirect targets for this function"
+                                % (name, insn.addr - self.func_of[insn.addr], insn.mnemonic))
+        found = [a for a, n in self.funcs.items() if any(re.search(t, n) for t in targets)]
+        if not found:
+            raise AnalysisError("%s: no function matches %s" % (name, ", ".join(targets)))
+        return max(self.wcet(a) for a in found)
+
+    def successors(self, name, addrs, insn):
+        """(cycles, next address or None when leaving the function) pairs."""
+        m = insn.mnemonic
+        nxt = insn.addr + insn.size
+        if m in ("ret", "reti"):
+            return [(CYCLES[m], None)]
+        if m in BRANCHES:
+            return [(1, nxt), (2, insn.target())]
+        if m in SKIPS:
+            skipped = self.insns.get(nxt)
+            after = nxt + (skipped.size if skipped else 2)
+            return [(1, nxt), (2 if skipped is None or skipped.size == 2 else 3, after)]
+        if m in ("rjmp", "jmp"):
+            target = insn.target()
+            if self.func_of.get(target) == self.func_of[insn.addr] and target != self.func_of[insn.addr]:
+                return [(CYCLES[m], target)]
+            cost, how = self.callee_cost(name, insn)
+            if how == "table":
+                return [(CYCLES[m] + cost, a) for a in addrs if a > insn.addr]
+            return [(CYCLES[m] + cost, None)]
+        if m in ("call", "rcall"):
+            cost, how = self.callee_cost(name, insn)
+            if how == "table":
+                return [(CYCLES[m] + cost, a) for a in addrs if a > insn.addr]
+            return [(CYCLES[m] + cost, nxt)]
+        if m in ("icall", "eicall"):
+            return [(CYCLES["icall"] + self.indirect_cost(name, insn), nxt)]
+        if m in ("ijmp", "eijmp"):
+            return [(CYCLES["ijmp"] + self.indirect_cost(name, insn), None)]
+        if m not in CYCLES:
+            raise AnalysisError("%s+0x%x: unknown instruction %s"
+                                % (name, insn.addr - self.func_of[insn.addr], m))
+        return [(CYCLES[m], nxt)]
+
+    def region(self, name, addrs, lo, hi, head):
+        """Longest path from each address in [lo, hi] to leaving the range,
+        returning, or (for a loop body) jumping back to its head. Loops are
+        collapsed innermost first into their bound times their body."""
+        best = {}
+        inside = [a for a in addrs if lo <= a <= hi]
+        for a in reversed(inside):
+            insn = self.insns[a]
+            back = [b for b in inside if b >= a and self.jumps_back_to(name, addrs, b, a)]
+            if back and a != head:
+                end = max(back)
+                bound = self.matching(self.loop_bounds, name)
+                if bound is None:
+                    raise AnalysisError("%s+0x%x: loop with no --loop-bound for this function"
+                                        % (name, a - self.func_of[a]))
+                body = self.region(name, addrs, a, end, a)[a]
+                # Conservatively, every iteration is the longest one and the
+                # loop may be left from anywhere inside it.
+                out = 0
+                for b in (x for x in inside if a <= x <= end):
+                    for cycles, s in self.successors(name, addrs, self.insns[b]):
+                        if s is not None and (s < a or s > end):
+                            if s < a:
+                                raise AnalysisError("%s+0x%x: jump out of a loop to an earlier address"
+                                                    % (name, b - self.func_of[b]))
+                            out = max(out, best.get(s, 0))
+                best[a] = bound * body + out
+                continue
+            longest = 0
+            for cycles, s in self.successors(name, addrs, insn):
+                if s is None or s > hi or s == head:
+                    longest = max(longest, cycles)
+                elif s > a:
+                    longest = max(longest, cycles + best[s])
+                elif s < lo:
+                    raise AnalysisError("%s+0x%x: jump into an enclosing loop"
+                                        % (name, a - self.func_of[a]))
+                # Other backward edges close an inner loop, accounted for
+                # at its head.
+            best[a] = longest
+        return best
+
+    def jumps_back_to(self, name, addrs, b, a):
+        insn = self.insns[b]
+        if insn.mnemonic not in BRANCHES and insn.mnemonic not in ("rjmp", "jmp"):
+            return False
+        target = insn.target()
+        return target == a and b >= a and self.func_of.get(target) == self.func_of[b]
+
+
+def parse_pairs(values, convert):
+    table = []
+    for v in values:
+        pattern, _, value = v.partition("=")
+        if not value:
+            raise SystemExit("expected REGEX=VALUE, got '%s'" % v)
+        table.append((pattern, convert(value)))
+    return table
+
+
+def read_config(path):
+    defines = {}
+    with open(path) as f:
+        for line in f:
+            m = re.match(r"\s*#define\s+(\w+)\s+(\d+)", line)
+            if m:
+                defines[m.group(1)] = int(m.group(2))
+    return defines
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf")
+    parser.add_argument("--objdump", default="avr-objdump")
+    parser.add_argument("--config", required=True, help="firmware config.h")
+    parser.add_argument("--f-cpu", type=int, default=7372800)
+    parser.add_argument("--ps2-clock-hz", type=int, default=16700,
+                        help="fastest PS/2 clock to allow for")
+    parser.add_argument("--loop-bound", action="append", default=[], metavar="REGEX=N",
+                        help="iterations of the loops in the matching functions")
+    parser.add_argument("--indirect", action="append", default=[], metavar="REGEX=T1,T2",
+                        help="functions the matching functions may call indirectly")
+    args = parser.parse_args()
+
+    config = read_config(args.config)
+    disassembly = subprocess.run([args.objdump, "-d", args.elf], check=True,
+                                 stdout=subprocess.PIPE, universal_newlines=True).stdout
+    program = Program(disassembly, parse_pairs(args.loop_bound, int),
+                      parse_pairs(args.indirect, lambda v: v.split(",")))
+
+    # Vector table: one jmp per vector, unused ones go to __bad_interrupt.
+    vectors = {}
+    try:
+        for n, name in VECTOR_NAMES.items():
+            insn = program.insns.get(4 * n)
+            if insn is None or insn.mnemonic != "jmp":
+                continue
+            target = insn.target()
+            if program.funcs.get(target, "__bad_interrupt") == "__bad_interrupt":
+                continue
+            vectors[name] = RESPONSE_CYCLES + CYCLES["jmp"] + program.wcet(target)
+    except AnalysisError as e:
+        print("isr_budget: %s" % e, file=sys.stderr)
+        return 2
+
+    us = 1e6 / args.f_cpu
+    print("%-14s %8s %9s" % ("vector", "cycles", "us"))
+    for name, cycles in vectors.items():
+        print("%-14s %8d %9.1f" % (name, cycles, cycles * us))
+
+    # Deadlines: PS/2 clock interrupts of both devices, and USART receive.
+    deadlines = {}
+    ps2_bit = args.f_cpu // args.ps2_clock_hz
+    for define in ("PS2_MOUSE_CLK_PIN", "PS2_KEYBOARD_CLK_PIN"):
+        vector = INT_PINS.get(config.get(define))
+        if vector in vectors:
+            deadlines[vector] = (ps2_bit, "PS/2 bit at %d Hz" % args.ps2_clock_hz)
+    baud = max(config.get("SERIAL_BAUD_RATE", 0), config.get("SERIAL_BAUD_RATE_MAX", 0))
+    if "USART_RX" in vectors and baud:
+        byte = 10 * args.f_cpu // baud
+        deadlines["USART_RX"] = (byte, "byte at %d baud" % baud)
+
+    order = list(VECTOR_NAMES.values())
+    failed = False
+    print()
+    for vector, (budget, what) in deadlines.items():
+        # Higher priority deadline handlers may each run once first, after
+        # the longest of the others that was already running.
+        ahead = [v for v in deadlines if order.index(v) < order.index(vector)]
+        others = [vectors[v] for v in vectors if v != vector and v not in ahead]
+        worst = vectors[vector] + sum(vectors[v] for v in ahead) + max(others, default=0)
+        ok = worst <= budget
+        failed |= not ok
+        print("%-14s %8d of %6d cycles (%s): %s" % (vector, worst, budget, what,
+                                                  "ok" if ok else "OVER BUDGET"))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,76 @@
+// trace.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "hal.h"
+#include "trace.h"
+
+#if TRACE_ENA
+
+static uint8_t g_ring[TRACE_RING_SIZE][TRACE_ENTRY_SIZE];
+static uint8_t g_head, g_count;
+static uint16_t g_lost;
+
+void trace_event(const uint8_t id, const uint16_t a, const uint16_t b, const uint8_t c)
+{
+    const uint16_t now = (uint16_t)hal_millis();
+    // Events may come from the reset timer interrupt too.
+    const uint8_t state = hal_irq_save();
+    uint8_t *e = g_ring[(g_head + g_count) % TRACE_RING_SIZE];
+    if (g_count < TRACE_RING_SIZE) {
+        g_count++;
+    } else {
+        g_head = (g_head + 1) % TRACE_RING_SIZE;
+        if (g_lost != 0xffff)
+            g_lost++;
+    }
+    e[0] = now >> 8;
+    e[1] = now & 0xff;
+    e[2] = id;
+    e[3] = a >> 8;
+    e[4] = a & 0xff;
+    e[5] = b >> 8;
+    e[6] = b & 0xff;
+    e[7] = c;
+    hal_irq_restore(state);
+}
+
+void trace_clear(void)
+{
+    const uint8_t state = hal_irq_save();
+    g_head = g_count = 0;
+    g_lost = 0;
+    hal_irq_restore(state);
+}
+
+uint8_t trace_count(void)
+{
+    return g_count;
+}
+
+uint16_t trace_take_lost(void)
+{
+    const uint8_t state = hal_irq_save();
+    const uint16_t lost = g_lost;
+    g_lost = 0;
+    hal_irq_restore(state);
+    return lost;
+}
+
+bool trace_pop(uint8_t entry[TRACE_ENTRY_SIZE])
+{
+    const uint8_t state = hal_irq_save();
+    const bool any = g_count > 0;
+    if (any) {
+        memcpy(entry, g_ring[g_head], TRACE_ENTRY_SIZE);
+        g_head = (g_head + 1) % TRACE_RING_SIZE;
+        g_count--;
+    }
+    hal_irq_restore(state);
+    return any;
+}
+
+#endif // TRACE_ENA
@@ -0,0 +1,64 @@
+// trace.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+
+// Optional event trace (TRACE_ENA): events with up to 5 bytes of
+// arguments, time stamped in ms, kept in a RAM ring where new events
+// overwrite the oldest. The host drains it with the vendor IKBD command
+// 0xB4 and decodes it with host/ikbd_trace.c. Without TRACE_ENA the TRACE
+// macros compile to nothing, arguments included.
+
+enum {
+#define TRACE_ID(name, payload, format) TRACE_##name,
+#include "trace_ids.h"
+#undef TRACE_ID
+};
+
+#define TRACE_RING_SIZE 32
+#define TRACE_ENTRY_SIZE 8      // time (2), id, a (2), b (2), c
+
+#define TRACE_BYTES(hi, lo) ((uint16_t)((uint8_t)(hi) << 8 | (uint8_t)(lo)))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if TRACE_ENA
+
+void trace_event(uint8_t id, uint16_t a, uint16_t b, uint8_t c);
+
+void trace_clear(void);
+// Number of events in the ring.
+uint8_t trace_count(void);
+// Events overwritten since the last call.
+uint16_t trace_take_lost(void);
+// Remove the oldest event, as TRACE_ENTRY_SIZE bytes. False if none left.
+bool trace_pop(uint8_t entry[TRACE_ENTRY_SIZE]);
+
+#define TRACE(id) trace_event(TRACE_##id, 0, 0, 0)
+#define TRACE1(id, a) trace_event(TRACE_##id, (a), 0, 0)
+#define TRACE2(id, a, b) trace_event(TRACE_##id, (a), (b), 0)
+#define TRACE3(id, a, b, c) trace_event(TRACE_##id, (a), (b), (c))
+
+#else
+
+#define TRACE(id) do { } while (0)
+#define TRACE1(id, a) do { } while (0)
+#define TRACE2(id, a, b) do { } while (0)
+#define TRACE3(id, a, b, c) do { } while (0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,37 @@
+// trace_ids.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+// Trace events: TRACE_ID(name, payload, format). Included by trace.h for
+// the TRACE_xxx ids and by host/ikbd_trace.c to decode a drained ring.
+// New events go at the end, so that old captures still decode.
+//
+// Payload says how to read the 5 argument bytes (a and b big endian, then
+// c) for the printf format: 'w' signed 16 bits, 'W' unsigned 16 bits, 'b'
+// unsigned 8 bits. Pack two bytes in a with TRACE_BYTES(hi, lo).
+
+TRACE_ID(INIT, "", "ikbd init")
+TRACE_ID(BOOT_ROM, "W", "ikbd boot rom clear_all=%d")
+TRACE_ID(STOP_MEMORY_LOAD, "", "ikbd stop memory load and turn off custom exe")
+TRACE_ID(RESET_DONE, "", "ikbd reset done, starting reset timer")
+TRACE_ID(OUTPUT_FULL, "W", "ikbd output buffer is full, can't send %d bytes")
+TRACE_ID(SEND_DURING_RESET, "W", "ikbd is resetting, can't send byte=0x%02x")
+TRACE_ID(COMMAND, "W", "command 0x%02x")
+TRACE_ID(RESET_BUG_12_1A, "", "commands 0x12 and 0x1a received during reset, enabling joystick and mouse reporting")
+TRACE_ID(RESET_BUG_08_14, "", "commands 0x08 and 0x14 received during reset, enabling joystick and mouse reporting")
+TRACE_ID(RESET_BUG_12_14, "", "commands 0x12 and 0x14 received during reset, enabling joystick and mouse reporting")
+TRACE_ID(REPORT_ABS_ON_ACTION, "", "report absolute mouse position on mouse action")
+TRACE_ID(MOUSE_ACTION, "W", "mouse action %d")
+TRACE_ID(ABS_MOUSE_MODE, "WW", "absolute mouse mode, max %d,%d")
+TRACE_ID(MOUSE_KEYCODES, "WW", "mouse cursor keycodes %d,%d")
+TRACE_ID(MOUSE_THRESHOLD, "WW", "mouse threshold %d,%d")
+TRACE_ID(MOUSE_SCALE, "WW", "mouse scale %d,%d")
+TRACE_ID(READ_ABS_MOUSE, "WWb", "absolute mouse position %d,%d buttons 0x%x")
+TRACE_ID(SET_MOUSE_POSITION, "WW", "set internal mouse position %d,%d")
+TRACE_ID(STOP_TRANSFER_IGNORED, "", "stop keyboard transfer ignored during ikbd reset")
+TRACE_ID(JOYSTICK_MONITORING, "W", "joystick monitoring rate %d")
+TRACE_ID(NOT_IMPLEMENTED, "W", "command 0x%02x not implemented")
+TRACE_ID(PS2_MOUSE_PARAMS, "bbbb", "PS/2 mouse rate %d, resolution %d, scaling %d, remote %d")
+TRACE_ID(KEYBOARD_LEDS, "WW", "keyboard LEDs 0x%x, host control %d")
+TRACE_ID(SNAPSHOT_RESTORED, "WW", "state restored after MCU reset, mouse mode %d, joystick mode %d")
+TRACE_ID(KEYS_RELEASED, "W", "released %d keys after lost keyboard input")
@@ -22,6 +22,16 @@ void send_byte(unsigned char c)
     Serial.write(c);
 }
 
+int send_room(void)
+{
+    return Serial.availableForWrite();
+}
+
+int send_pending(void)
+{
+    return SERIAL_TX_BUFFER_SIZE - 1 - Serial.availableForWrite();
+}
+
 void send_str(const char *str)
 {
     while(*str) {
@@ -7,6 +7,10 @@
 
 unsigned char recv_byte(bool *avail);
 void send_byte(unsigned char c);
+// Bytes send_byte() takes without waiting.
+int send_room(void);
+// Bytes sent but still waiting to go out on the line.
+int send_pending(void);
 void send_str(const char *str);
 
 #endif
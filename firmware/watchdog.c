@@ -0,0 +1,98 @@
+// watchdog.c
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#include "watchdog.h"
+
+#include <string.h>
+
+#include "eeprom.h"
+#include "eeprom_map.h"
+#include "hal.h"
+
+#if 2 * WATCHDOG_STAGES > EEPROM_WATCHDOG_SIZE
+#error "watchdog counts don't fit their EEPROM region"
+#endif
+
+// Kept across a reset, each with its complement to tell it from the
+// random contents of RAM after power up.
+static uint8_t g_stage HAL_NOINIT, g_stage_check HAL_NOINIT;
+static uint8_t g_resets HAL_NOINIT, g_resets_check HAL_NOINIT;
+
+static uint8_t g_stalled = WATCHDOG_NONE;
+// The counts as in the EEPROM, big endian.
+static uint8_t g_counts[2 * WATCHDOG_STAGES];
+// Next byte of the counts to check, 2 * WATCHDOG_STAGES when up to date.
+static uint8_t g_save_pos = 2 * WATCHDOG_STAGES;
+
+void watchdog_begin(void)
+{
+    const uint8_t cause = hal_reset_cause();
+    if (cause & HAL_RESET_POWER_ON || g_resets_check != (uint8_t)~g_resets)
+        g_resets = 0;
+
+    // An erased EEPROM reads as no stalls.
+    for (uint8_t i = 0; i < WATCHDOG_STAGES; i++) {
+        g_counts[2 * i] = hal_eeprom_read(EEPROM_WATCHDOG_ADDR + 2 * i);
+        g_counts[2 * i + 1] = hal_eeprom_read(EEPROM_WATCHDOG_ADDR + 2 * i + 1);
+        if (watchdog_count(i) == 0xFFFF)
+            g_counts[2 * i] = g_counts[2 * i + 1] = 0;
+    }
+
+    g_stalled = WATCHDOG_NONE;
+    if (cause & HAL_RESET_WATCHDOG && g_stage < WATCHDOG_STAGES && g_stage_check == (uint8_t)~g_stage) {
+        g_stalled = g_stage;
+        const uint16_t count = watchdog_count(g_stalled);
+        if (count < 0xFFFE) {
+            g_counts[2 * g_stalled] = (count + 1) >> 8;
+            g_counts[2 * g_stalled + 1] = (count + 1) & 0xFF;
+        }
+        if (g_resets < 0xFF)
+            g_resets++;
+        g_save_pos = 0;
+    }
+    g_resets_check = ~g_resets;
+
+    hal_watchdog_start(WATCHDOG_SETUP_MS);
+    watchdog_check_in(WATCHDOG_SETUP);
+}
+
+void watchdog_run(void)
+{
+    hal_watchdog_start(WATCHDOG_LOOP_MS);
+}
+
+void watchdog_check_in(const uint8_t stage)
+{
+    g_stage = stage;
+    g_stage_check = ~stage;
+    hal_watchdog_kick();
+}
+
+uint8_t watchdog_stalled(void)
+{
+    return g_stalled;
+}
+
+uint16_t watchdog_count(const uint8_t stage)
+{
+    return stage < WATCHDOG_STAGES ? g_counts[2 * stage] << 8 | g_counts[2 * stage + 1] : 0;
+}
+
+uint8_t watchdog_resets(void)
+{
+    return g_resets;
+}
+
+void watchdog_clear(void)
+{
+    memset(g_counts, 0, sizeof(g_counts));
+    g_resets = 0;
+    g_resets_check = ~g_resets;
+    g_save_pos = 0;
+}
+
+void watchdog_poll(void)
+{
+    eeprom_sync(EEPROM_WATCHDOG_ADDR, g_counts, sizeof(g_counts), &g_save_pos);
+}
@@ -0,0 +1,66 @@
+// watchdog.h
+// Copyright (c) 2025 Rob Gowin
+// SPDX-License-Identifier: MIT
+
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Watchdog supervision of setup() and loop(). Each stage checks in as it
+// starts, which kicks the watchdog and notes the stage in RAM that keeps
+// its value across a reset. If a stage hangs, the watchdog resets the MCU;
+// on the way back up the stalled stage is counted, the counts kept in
+// EEPROM, and the host's IKBD setup is restored (snapshot.h). The counts
+// are read with the vendor IKBD command 0xBA and cleared with 0x3A.
+
+// A loop() stage that takes longer than this resets the MCU.
+#define WATCHDOG_LOOP_MS 60
+// setup() waits up to Settings.ps2_timeout_ms for each device to answer.
+#define WATCHDOG_SETUP_MS 8000
+
+enum {
+    WATCHDOG_SETUP,                 // settings, remap and IKBD state
+    WATCHDOG_SETUP_KEYBOARD,        // PS/2 keyboard reset
+    WATCHDOG_SETUP_MOUSE,           // PS/2 mouse reset
+    WATCHDOG_COMMAND,               // the stages of loop(), as in profile.h
+    WATCHDOG_MOUSE,
+    WATCHDOG_KEYBOARD,
+    WATCHDOG_CONFIG,
+    WATCHDOG_REPORT,
+    WATCHDOG_OUTPUT,
+    WATCHDOG_SAVE,                  // EEPROM writes and macros
+    WATCHDOG_STAGES
+};
+
+#define WATCHDOG_NONE 0xFF
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// First thing in setup(): count the stage that stalled, if the watchdog
+// caused the last reset, and arm the watchdog for setup().
+void watchdog_begin(void);
+// End of setup(): from now on, stages must check in every WATCHDOG_LOOP_MS.
+void watchdog_run(void);
+
+void watchdog_check_in(uint8_t stage);
+
+// Stage whose stall caused the last reset, or WATCHDOG_NONE.
+uint8_t watchdog_stalled(void);
+// Stalls of a stage, kept in EEPROM. Saturates at 0xFFFE.
+uint16_t watchdog_count(uint8_t stage);
+// Watchdog resets since power up.
+uint8_t watchdog_resets(void);
+void watchdog_clear(void);
+
+// Write the next changed byte of the counts to the EEPROM.
+void watchdog_poll(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WATCHDOG_H